@@ -27,6 +27,8 @@ Acceptor::Acceptor(EventLoop* loop, const IpPort& listenAddr, int reuseport)
     mSocket.set_reuseaddr(1);
     mSocket.set_reuseport(reuseport);
     mSocket.bind(listenAddr);
+    mChannel.set_name("acceptor");
+    mChannel.set_priority(ChannelPriority::HIGH);
     mChannel.set_read_callback(std::bind(&Acceptor::handle_read, this));
 }
 
@@ -8,6 +8,7 @@
 #include <utility>
 
 #include "endian.hpp"
+#include "../util/byte_search.hpp"
 #include "../util/logger.hpp"
 
 namespace Asuka
@@ -16,29 +17,39 @@ namespace Asuka
 namespace Net
 { 
 
-const char Buffer::kCRLF[] = "\r\n";
 const std::size_t Buffer::kInitialSize = 1024;
 const std::size_t Buffer::kPrependSize = 8;
 
 
-Buffer::Buffer(std::size_t initSize)
-    : mBuffer(initSize + kPrependSize),
-      mReaderIndex(kPrependSize),
-      mWriterIndex(kPrependSize)
+Buffer::Buffer(std::size_t initSize, std::size_t prependSize)
+    : mBuffer(initSize + prependSize),
+      mReaderIndex(prependSize),
+      mWriterIndex(prependSize),
+      mPrependSize(prependSize)
+{
+}
+
+Buffer::Buffer(NoStorage, std::size_t prependSize)
+    : mBuffer(),
+      mReaderIndex(0),
+      mWriterIndex(0),
+      mPrependSize(prependSize)
 {
 }
 
 Buffer::Buffer(const Buffer& rhs)
     : mBuffer(rhs.mBuffer),
       mReaderIndex(rhs.mReaderIndex),
-      mWriterIndex(rhs.mWriterIndex)
+      mWriterIndex(rhs.mWriterIndex),
+      mPrependSize(rhs.mPrependSize)
 {
 }
 
 Buffer::Buffer(Buffer&& rhs) noexcept
     : mBuffer(std::move(rhs.mBuffer)),
       mReaderIndex(rhs.mReaderIndex),
-      mWriterIndex(rhs.mWriterIndex)
+      mWriterIndex(rhs.mWriterIndex),
+      mPrependSize(rhs.mPrependSize)
 {
     rhs.mReaderIndex = 0;
     rhs.mWriterIndex = 0;
@@ -49,6 +60,7 @@ void Buffer::swap(Buffer& rhs) noexcept
     mBuffer.swap(rhs.mBuffer);
     std::swap(mReaderIndex, rhs.mReaderIndex);
     std::swap(mWriterIndex, rhs.mWriterIndex);
+    std::swap(mPrependSize, rhs.mPrependSize);
 }
 
 Buffer& Buffer::operator=(const Buffer& rhs)
@@ -88,6 +100,11 @@ std::size_t Buffer::prepend_bytes() const
     return mReaderIndex;
 }
 
+std::size_t Buffer::get_prepend_size() const
+{
+    return mPrependSize;
+}
+
 const char* Buffer::peek() const
 {
     return mBuffer.data() + mReaderIndex;
@@ -95,7 +112,7 @@ const char* Buffer::peek() const
 
 const char* Buffer::find_crlf() const
 {
-    const char* crlf = std::search(read_begin(), write_begin(), kCRLF, kCRLF + 2);
+    const char* crlf = Asuka::find_crlf(read_begin(), write_begin());
     return crlf == write_begin() ? nullptr : crlf;
 }
 
@@ -103,13 +120,13 @@ const char* Buffer::find_crlf(const char* start) const
 {
     assert(start >= read_begin());
     assert(start < write_begin());
-    const char* crlf = std::search(start, write_begin(), kCRLF, kCRLF + 2);
+    const char* crlf = Asuka::find_crlf(start, write_begin());
     return crlf == write_begin() ? nullptr : crlf;
 }
 
 const char* Buffer::find_eol() const
 {
-    const char* eol = std::find(read_begin(), write_begin(), '\n');
+    const char* eol = find_byte(read_begin(), write_begin(), '\n');
     return eol == write_begin() ? nullptr : eol;
 }
 
@@ -117,10 +134,54 @@ const char* Buffer::find_eol(const char* start) const
 {
     assert(start >= read_begin());
     assert(start < write_begin());
-    const char* eol = std::find(start, write_begin(), '\n');
+    const char* eol = find_byte(start, write_begin(), '\n');
     return eol == write_begin() ? nullptr : eol;
 }
 
+const char* Buffer::find_any_of(const StringView& set) const
+{
+    const char* p = Asuka::find_any_of(read_begin(), write_begin(), 
+        set.data(), set.size());
+    return p == write_begin() ? nullptr : p;
+}
+
+const char* Buffer::find_any_of(const char* start, const StringView& set) const
+{
+    assert(start >= read_begin());
+    assert(start < write_begin());
+    const char* p = Asuka::find_any_of(start, write_begin(), 
+        set.data(), set.size());
+    return p == write_begin() ? nullptr : p;
+}
+
+const char* Buffer::find_crlf_from(std::size_t& scanned) const
+{
+    assert(scanned <= readable_bytes());
+    // the last scanned byte may be the '\r' of a crlf
+    std::size_t from = scanned > 0 ? scanned - 1 : 0;
+    const char* crlf = Asuka::find_crlf(read_begin() + from, write_begin());
+    if (crlf == write_begin())
+    {
+        scanned = readable_bytes();
+        return nullptr;
+    }
+
+    return crlf;
+}
+
+const char* Buffer::find_eol_from(std::size_t& scanned) const
+{
+    assert(scanned <= readable_bytes());
+    const char* eol = find_byte(read_begin() + scanned, write_begin(), '\n');
+    if (eol == write_begin())
+    {
+        scanned = readable_bytes();
+        return nullptr;
+    }
+
+    return eol;
+}
+
 char* Buffer::read_begin()
 {
     return const_cast<char*>(
@@ -145,22 +206,23 @@ const char* Buffer::write_begin() const
 
 char* Buffer::begin()
 {
-    return &*mBuffer.begin();
+    // not &*mBuffer.begin(), the buffer may have no storage
+    return mBuffer.data();
 }
 
 const char* Buffer::begin() const
 {
-    return &*mBuffer.begin();
+    return mBuffer.data();
 }
 
 char* Buffer::end()
 {
-    return &*mBuffer.end();
+    return mBuffer.data() + mBuffer.size();
 }
 
 const char* Buffer::end() const
 {
-    return &*mBuffer.end();
+    return mBuffer.data() + mBuffer.size();
 }
 
 std::size_t Buffer::size() const
@@ -183,6 +245,38 @@ void Buffer::shrink_to_fit()
     mBuffer.shrink_to_fit();
 }
 
+void Buffer::shrink(std::size_t reserve)
+{
+    Buffer other(readable_bytes() + reserve, mPrependSize);
+    other.append(read_begin(), readable_bytes());
+    swap(other);
+}
+
+bool Buffer::has_storage() const
+{
+    return !mBuffer.empty();
+}
+
+std::vector<char> Buffer::release_storage()
+{
+    assert(readable_bytes() == 0);
+    std::vector<char> storage;
+    storage.swap(mBuffer);
+    mReaderIndex = 0;
+    mWriterIndex = 0;
+
+    return storage;
+}
+
+void Buffer::adopt_storage(std::vector<char>&& storage)
+{
+    assert(readable_bytes() == 0);
+    assert(storage.size() > mPrependSize);
+    mBuffer = std::move(storage);
+    mReaderIndex = mPrependSize;
+    mWriterIndex = mPrependSize;
+}
+
 void Buffer::retrieve(std::size_t len)
 {
     assert(len <= readable_bytes());
@@ -198,8 +292,9 @@ void Buffer::retrieve(std::size_t len)
 
 void Buffer::retrieve_all()
 {
-    mReaderIndex = kPrependSize;
-    mWriterIndex = kPrependSize;
+    // a buffer without storage has no prependable bytes
+    mReaderIndex = has_storage() ? mPrependSize : 0;
+    mWriterIndex = mReaderIndex;
 }
 
 void Buffer::retrieve_util(const char* end)
@@ -291,16 +386,22 @@ void Buffer::append_uint8(std::uint8_t x)
 ssize_t Buffer::read_fd(int fd, int& savedError)
 {
     char extrabuf[65536];
+    return read_fd(fd, savedError, extrabuf, sizeof(extrabuf));
+}
+
+ssize_t Buffer::read_fd(int fd, int& savedError, 
+                        char* extrabuf, std::size_t extraLen)
+{
     struct iovec vec[2];
     const std::size_t writable = writable_bytes();
 
     vec[0].iov_base = write_begin();
     vec[0].iov_len  = writable;
     vec[1].iov_base = extrabuf;
-    vec[1].iov_len  = sizeof(extrabuf);
+    vec[1].iov_len  = extraLen;
 
     // when there is enough space in the buffer, don't read into extrabuf
-    const int iovcnt = writable < sizeof(extrabuf) ? 2 : 1;
+    const int iovcnt = writable < extraLen ? 2 : 1;
     const ssize_t n = ::readv(fd, vec, iovcnt);
     if (n < 0)
     {
@@ -321,10 +422,16 @@ ssize_t Buffer::read_fd(int fd, int& savedError)
 
 void Buffer::ensure_writable_bytes(std::size_t len)
 {
-    if (writable_bytes() < len)
+    if (!has_storage())
+    {
+        mBuffer.resize(len + mPrependSize);
+        mReaderIndex = mPrependSize;
+        mWriterIndex = mPrependSize;
+    }
+    else if (writable_bytes() < len)
     {
         // make space
-        if (writable_bytes() + prepend_bytes() < len + kPrependSize)
+        if (writable_bytes() + prepend_bytes() < len + mPrependSize)
         {
             // mBuffer can't hold the data
             mBuffer.resize(len + mWriterIndex);
@@ -333,13 +440,13 @@ void Buffer::ensure_writable_bytes(std::size_t len)
         {
             // mBuffer can hold the data
             // only move forward 
-            assert(kPrependSize < mReaderIndex);
+            assert(mPrependSize < mReaderIndex);
             std::size_t readable = readable_bytes();
             std::copy(begin() + mReaderIndex,
                       begin() + mWriterIndex,
-                      begin() + kPrependSize);
+                      begin() + mPrependSize);
             // adjust the index
-            mReaderIndex = kPrependSize;
+            mReaderIndex = mPrependSize;
             mWriterIndex = mReaderIndex + readable;
             assert(readable == readable_bytes());
         }
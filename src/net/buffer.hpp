@@ -2,9 +2,12 @@
 #ifndef ASUKA_BUFFER_HPP
 #define ASUKA_BUFFER_HPP
 
+#include <cassert>
+#include <cstring>
 #include <vector>
 
 #include "../util/string_view.hpp"
+#include "endian.hpp"
 
 namespace Asuka
 {
@@ -29,7 +32,17 @@ namespace Net
 class Buffer
 {
 public:
-    explicit Buffer(std::size_t initSize = kInitialSize);
+    // `prependSize` bytes are reserved in front of the readable bytes,
+    // so a header can be prepended after the body has been appended
+    explicit Buffer(std::size_t initSize = kInitialSize,
+                    std::size_t prependSize = kPrependSize);
+
+    // tag of the constructor below
+    struct NoStorage {};
+
+    // a buffer without storage, see has_storage()
+    explicit Buffer(NoStorage, std::size_t prependSize = kPrependSize);
+
     Buffer(const Buffer& rhs);
     Buffer(Buffer&& rhs) noexcept;
 
@@ -42,6 +55,9 @@ public:
     std::size_t writable_bytes() const;
     std::size_t prepend_bytes() const;
 
+    // the headroom reserved after retrieving all
+    std::size_t get_prepend_size() const;
+
     // return the pointer to where start reading
     const char* peek() const;
 
@@ -53,6 +69,17 @@ public:
     const char* find_eol() const;
     const char* find_eol(const char* start) const;
 
+    // find any byte of `set`
+    const char* find_any_of(const StringView& set) const;
+    const char* find_any_of(const char* start, const StringView& set) const;
+
+    // resumable search, `scanned` is the number of readable bytes
+    // which have been searched, it is updated if not found,
+    // so the prefix is not scanned again when more data arrives
+    // reset `scanned` to 0 after retrieving
+    const char* find_crlf_from(std::size_t& scanned) const;
+    const char* find_eol_from(std::size_t& scanned) const;
+
     // the pointer to where start reading
     char* read_begin();
     const char* read_begin() const;
@@ -74,6 +101,24 @@ public:
 
     void reserve(std::size_t sizeBuf);
     void shrink_to_fit();
+    // keep the readable bytes and `reserve` writable bytes,
+    // free the rest of the storage
+    void shrink(std::size_t reserve);
+
+    // make sure there are at least `len` writable bytes
+    // move the readable bytes forward or grow the buffer if necessary
+    void ensure_writable_bytes(std::size_t len);
+
+    // a buffer without storage holds no memory, e.g. moved from
+    // it allocates again when appending data
+    bool has_storage() const;
+
+    // give the storage away, the buffer must have no readable bytes
+    std::vector<char> release_storage();
+
+    // reuse `storage` whose size is larger than the prepend size
+    // the buffer must have no readable bytes
+    void adopt_storage(std::vector<char>&& storage);
 
     // advances the reading index of the buffer up len 
     // if len == readable_bytes, reset
@@ -86,6 +131,20 @@ public:
     void retrieve_int16();
     void retrieve_int8();
 
+    // read x with net endian at read buffer, but not retrieve
+    // requires readable_bytes() >= sizeof(x)
+    std::int64_t peek_int64() const;
+    std::int32_t peek_int32() const;
+    std::int16_t peek_int16() const;
+    std::int8_t peek_int8() const;
+
+    // read x with net endian at read buffer, and retrieve
+    // requires readable_bytes() >= sizeof(x)
+    std::int64_t read_int64();
+    std::int32_t read_int32();
+    std::int16_t read_int16();
+    std::int8_t read_int8();
+
     std::string retrieve_all_as_string();
     std::string retrieve_as_string(std::size_t len);
 
@@ -103,12 +162,27 @@ public:
     void append_uint16(std::uint16_t x);
     void append_uint8(std::uint8_t x);
 
+    // write `data` in front of read buffer, the readable bytes are not moved
+    // requires prepend_bytes() >= len
+    void prepend(const void* data, std::size_t len);
+
+    // prepend x with net endian in front of read buffer
+    // requires prepend_bytes() >= sizeof(x)
+    void prepend_int64(std::int64_t x);
+    void prepend_int32(std::int32_t x);
+    void prepend_int16(std::int16_t x);
+    void prepend_int8(std::int8_t x);
+
     // read data directly into buffer
     // on success, return the number of bytes read is returned
     // on error, return -1 and `savedError` is set appropriately
     ssize_t read_fd(int fd, int& savedError);
+
+    // same as above, but the overflow is read into `extrabuf` 
+    // instead of a buffer on the stack, e.g. a slab shared by a loop
+    ssize_t read_fd(int fd, int& savedError, 
+                    char* extrabuf, std::size_t extraLen);
 private:
-    void ensure_writable_bytes(std::size_t len);
     void add_writer_index(std::size_t len);
     void sub_writer_index(std::size_t len);
 
@@ -116,12 +190,102 @@ private:
     std::vector<char> mBuffer;
     std::size_t mReaderIndex;
     std::size_t mWriterIndex;
+    std::size_t mPrependSize;
 
-    static const char kCRLF[];
     static const std::size_t kInitialSize;
     static const std::size_t kPrependSize;
 };
 
+// the prepend and fixed-width integer accessors are inline for codecs
+
+inline std::int64_t Buffer::peek_int64() const
+{
+    assert(readable_bytes() >= sizeof(std::int64_t));
+    std::uint64_t be64;
+    std::memcpy(&be64, peek(), sizeof(be64));
+    return static_cast<std::int64_t>(net_to_host64(be64));
+}
+
+inline std::int32_t Buffer::peek_int32() const
+{
+    assert(readable_bytes() >= sizeof(std::int32_t));
+    std::uint32_t be32;
+    std::memcpy(&be32, peek(), sizeof(be32));
+    return static_cast<std::int32_t>(net_to_host32(be32));
+}
+
+inline std::int16_t Buffer::peek_int16() const
+{
+    assert(readable_bytes() >= sizeof(std::int16_t));
+    std::uint16_t be16;
+    std::memcpy(&be16, peek(), sizeof(be16));
+    return static_cast<std::int16_t>(net_to_host16(be16));
+}
+
+inline std::int8_t Buffer::peek_int8() const
+{
+    assert(readable_bytes() >= sizeof(std::int8_t));
+    return static_cast<std::int8_t>(*peek());
+}
+
+inline std::int64_t Buffer::read_int64()
+{
+    std::int64_t x = peek_int64();
+    retrieve_int64();
+    return x;
+}
+
+inline std::int32_t Buffer::read_int32()
+{
+    std::int32_t x = peek_int32();
+    retrieve_int32();
+    return x;
+}
+
+inline std::int16_t Buffer::read_int16()
+{
+    std::int16_t x = peek_int16();
+    retrieve_int16();
+    return x;
+}
+
+inline std::int8_t Buffer::read_int8()
+{
+    std::int8_t x = peek_int8();
+    retrieve_int8();
+    return x;
+}
+
+inline void Buffer::prepend(const void* data, std::size_t len)
+{
+    assert(len <= prepend_bytes());
+    mReaderIndex -= len;
+    std::memcpy(mBuffer.data() + mReaderIndex, data, len);
+}
+
+inline void Buffer::prepend_int64(std::int64_t x)
+{
+    std::uint64_t be64 = host_to_net64(static_cast<std::uint64_t>(x));
+    prepend(&be64, sizeof(be64));
+}
+
+inline void Buffer::prepend_int32(std::int32_t x)
+{
+    std::uint32_t be32 = host_to_net32(static_cast<std::uint32_t>(x));
+    prepend(&be32, sizeof(be32));
+}
+
+inline void Buffer::prepend_int16(std::int16_t x)
+{
+    std::uint16_t be16 = host_to_net16(static_cast<std::uint16_t>(x));
+    prepend(&be16, sizeof(be16));
+}
+
+inline void Buffer::prepend_int8(std::int8_t x)
+{
+    prepend(&x, sizeof(x));
+}
+
 } // namespace Net
 
 } // namespace Asuka
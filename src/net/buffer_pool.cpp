@@ -0,0 +1,72 @@
+﻿#include "buffer_pool.hpp"
+
+#include <utility>
+
+namespace Asuka
+{
+
+namespace Net
+{
+
+const std::size_t BufferPool::kSlabSize = 65536;
+const std::size_t BufferPool::kBlockSize = 4096;
+const std::size_t BufferPool::kDefaultMaxFreeBlocks = 1024;
+
+BufferPool::BufferPool()
+    : mSlab(kSlabSize),
+      mFreeBlocks(),
+      mMaxFreeBlocks(kDefaultMaxFreeBlocks)
+{
+}
+
+char* BufferPool::get_slab()
+{
+    return mSlab.data();
+}
+
+std::size_t BufferPool::get_slab_size() const
+{
+    return mSlab.size();
+}
+
+std::vector<char> BufferPool::acquire()
+{
+    if (mFreeBlocks.empty())
+    {
+        return std::vector<char>(kBlockSize);
+    }
+
+    std::vector<char> block = std::move(mFreeBlocks.back());
+    mFreeBlocks.pop_back();
+    return block;
+}
+
+void BufferPool::release(std::vector<char>&& block)
+{
+    if (block.size() == kBlockSize && mFreeBlocks.size() < mMaxFreeBlocks)
+    {
+        mFreeBlocks.push_back(std::move(block));
+    }
+    else
+    {
+        std::vector<char>{}.swap(block);
+    }
+}
+
+std::size_t BufferPool::free_blocks() const
+{
+    return mFreeBlocks.size();
+}
+
+void BufferPool::set_max_free_blocks(std::size_t num)
+{
+    mMaxFreeBlocks = num;
+    if (mFreeBlocks.size() > mMaxFreeBlocks)
+    {
+        mFreeBlocks.resize(mMaxFreeBlocks);
+    }
+}
+
+} // namespace Net
+
+} // namespace Asuka
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+#ifndef ASUKA_BUFFER_POOL_HPP
+#define ASUKA_BUFFER_POOL_HPP
+
+#include <vector>
+
+#include "../util/noncopyable.hpp"
+
+namespace Asuka
+{
+
+namespace Net
+{
+
+// BufferPool is owned by an EventLoop, and only used in the loop thread
+// - a read slab shared by all connections of the loop, 
+//   Buffer::read_fd reads the overflow into it
+// - a free list of fixed-size storage blocks, an idle connection gives
+//   its input buffer storage back, and takes one when data arrives
+class BufferPool : Noncopyable
+{
+public:
+    static const std::size_t kSlabSize;
+    static const std::size_t kBlockSize;
+    static const std::size_t kDefaultMaxFreeBlocks;
+
+public:
+    BufferPool();
+
+    char* get_slab();
+    std::size_t get_slab_size() const;
+
+    // return a storage block of `kBlockSize` bytes
+    std::vector<char> acquire();
+
+    // take back a storage block, 
+    // the one which has been resized or exceeds the limit is freed
+    void release(std::vector<char>&& block);
+
+    std::size_t free_blocks() const;
+    void set_max_free_blocks(std::size_t num);
+
+private:
+    std::vector<char> mSlab;
+    std::vector<std::vector<char>> mFreeBlocks;
+    std::size_t mMaxFreeBlocks;
+};
+
+} // namespace Net
+
+} // namespace Asuka
+
+#endif // ASUKA_BUFFER_POOL_HPP
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include <functional>
 #include <memory>
 
+#include "../util/task.hpp"
 #include "../util/time_stamp.hpp"
 
 namespace Asuka
@@ -13,7 +14,8 @@ namespace Asuka
 namespace Net
 {
 
-using TimerCallback = std::function<void()>;
+// move-only, small callables are stored without allocating
+using TimerCallback = Task;
 
 
 class Buffer;
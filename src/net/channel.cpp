@@ -25,7 +25,10 @@ Channel::Channel(EventLoop* loop, int fd)
       mIsTied(false),
       mIsEventHanding(false),
       mIsAddedInLoop(false),
-      mIsLogHup(true)
+      mIsLogHup(true),
+      mIsEdgeTriggered(false),
+      mPriority(ChannelPriority::NORMAL),
+      mName("")
 {
 }
 
@@ -152,6 +155,26 @@ bool Channel::is_writing() const
     return mEvents & kWriteEvent;
 }
 
+void Channel::set_edge_triggered(bool on)
+{
+    mIsEdgeTriggered = on;
+}
+
+bool Channel::is_edge_triggered() const
+{
+    return mIsEdgeTriggered;
+}
+
+void Channel::set_priority(ChannelPriority priority)
+{
+    mPriority = priority;
+}
+
+ChannelPriority Channel::get_priority() const noexcept
+{
+    return mPriority;
+}
+
 int Channel::get_index() const
 {
     return mIndex;
@@ -177,6 +200,16 @@ void Channel::set_not_loghup()
     mIsLogHup = false;
 }
 
+void Channel::set_name(const char* name)
+{
+    mName = name;
+}
+
+const char* Channel::get_name() const
+{
+    return mName;
+}
+
 void Channel::remove()
 {
     assert(is_none_event());
@@ -213,10 +246,25 @@ void Channel::update()
     mLoop->update_channel(*this);
 }
 
+void Channel::report_slow_callback(const char* kind, TimeStamp start,
+                                   std::int64_t thresholdUs) const
+{
+    std::int64_t us = TimeStamp::now().get_microseconds() 
+        - start.get_microseconds();
+    if (us >= thresholdUs)
+    {
+        LOG_WARN << "slow " << kind << " callback " << us << "us, fd = " 
+            << mFd << " name = " << mName;
+        mLoop->record_slow_handler();
+    }
+}
+
 void Channel::handle_event_with_guard(TimeStamp receivedTime)
 {
     mIsEventHanding = true;
     LOG_TRACE << revents_to_string();
+    // read once, no clock is read if the detector is off
+    const std::int64_t slowUs = mLoop->get_slow_handler_threshold();
 
     if ((mRevents & POLLHUP) && !(mRevents & POLLIN))
     {
@@ -227,7 +275,9 @@ void Channel::handle_event_with_guard(TimeStamp receivedTime)
         }
         if (mCloseCallback)
         {
+            TimeStamp start = callback_start(slowUs);
             mCloseCallback();
+            check_slow_callback("close", start, slowUs);
         }
     }
 
@@ -241,7 +291,9 @@ void Channel::handle_event_with_guard(TimeStamp receivedTime)
     {
         if (mErrorCallback)
         {
+            TimeStamp start = callback_start(slowUs);
             mErrorCallback();
+            check_slow_callback("error", start, slowUs);
         }
     }
 
@@ -249,7 +301,9 @@ void Channel::handle_event_with_guard(TimeStamp receivedTime)
     {
         if (mReadCallback)
         {
+            TimeStamp start = callback_start(slowUs);
             mReadCallback(receivedTime);
+            check_slow_callback("read", start, slowUs);
         }
     }
     
@@ -257,7 +311,9 @@ void Channel::handle_event_with_guard(TimeStamp receivedTime)
     {
         if (mWriteCallback)
         {
+            TimeStamp start = callback_start(slowUs);
             mWriteCallback();
+            check_slow_callback("write", start, slowUs);
         }
     }
 
@@ -17,6 +17,13 @@ namespace Net
 
 class EventLoop;
 
+// the active channels of a loop iteration are handled from HIGH to LOW
+enum class ChannelPriority
+{
+    HIGH,       // control, e.g. wakeup, timers and acceptors
+    NORMAL,     // default
+    LOW
+};
 
 // a selectable I/O channel
 // the Channel object doesn't own the file descriptor
@@ -61,6 +68,15 @@ public:
     bool is_reading() const;
     bool is_writing() const;
 
+    // the events are reported only when they change, if the poller
+    // supports it, see EventLoop::set_edge_triggered
+    // must be called before the events are enabled
+    void set_edge_triggered(bool on);
+    bool is_edge_triggered() const;
+
+    void set_priority(ChannelPriority priority);
+    ChannelPriority get_priority() const noexcept;
+
     // for poller
     int get_index() const;
     void set_index(int idx);
@@ -71,6 +87,11 @@ public:
 
     void set_not_loghup();
 
+    // the name is logged if a callback is slow, e.g. the connection name
+    // only the pointer is kept, the string must outlive the channel
+    void set_name(const char* name);
+    const char* get_name() const;
+
     void remove();
 
 private:
@@ -79,6 +100,25 @@ private:
     void update();
     void handle_event_with_guard(TimeStamp receivedTime);
 
+    // inline, nothing is called if the slow handler detector of the loop
+    // is off, i.e. `thresholdUs` is 0
+    static TimeStamp callback_start(std::int64_t thresholdUs)
+    {
+        return thresholdUs > 0 ? TimeStamp::now() : TimeStamp{};
+    }
+
+    void check_slow_callback(const char* kind, TimeStamp start,
+                             std::int64_t thresholdUs) const
+    {
+        if (thresholdUs > 0)
+        {
+            report_slow_callback(kind, start, thresholdUs);
+        }
+    }
+
+    void report_slow_callback(const char* kind, TimeStamp start,
+                              std::int64_t thresholdUs) const;
+
     static const std::uint32_t kNoneEvent;
     static const std::uint32_t kReadEvent;
     static const std::uint32_t kWriteEvent;
@@ -96,6 +136,9 @@ private:
     bool mIsEventHanding;
     bool mIsAddedInLoop;
     bool mIsLogHup;
+    bool mIsEdgeTriggered;
+    ChannelPriority mPriority;
+    const char* mName;
 
     ReadEventCallback mReadCallback;
     EventCallback mWriteCallback;
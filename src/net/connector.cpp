@@ -143,6 +143,7 @@ void Connector::connecting(int sockfd)
     set_status(kIsConnecting);
     assert(!mChannel);
     mChannel.reset(new Channel(mLoop, sockfd));
+    mChannel->set_name("connector");
     // FIXME unsafe
     mChannel->set_write_callback(
         std::bind(&Connector::handle_write, this));
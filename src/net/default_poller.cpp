@@ -2,7 +2,9 @@
 
 #include "../util/config.hpp"
 #include "epoller.hpp"
+#include "../util/logger.hpp"
 #include "poller.hpp"
+#include "uring_poller.hpp"
 
 namespace Asuka
 {
@@ -11,14 +13,33 @@ namespace Net
 {
 
 std::unique_ptr<PollerBase> PollerBase::create_default_poller(EventLoop* loop)
+{
+    return create_poller(loop, Config::instance().get_poller_type());
+}
+
+std::unique_ptr<PollerBase> PollerBase::create_poller(EventLoop* loop,
+                                                      PollerType type)
 {
     std::unique_ptr<PollerBase> result{ nullptr };
-    bool useEpoll = Config::instance().get_use_epoll();
-    if (useEpoll)
+    if (type == PollerType::IO_URING)
+    {
+        std::unique_ptr<UringPoller> poller{ new UringPoller{ loop } };
+        if (poller->is_open())
+        {
+            result = std::move(poller);
+        }
+        else
+        {
+            LOG_WARN << "io_uring is unavailable, use epoll instead";
+            type = PollerType::EPOLL;
+        }
+    }
+
+    if (type == PollerType::EPOLL)
     {
         result.reset(new Epoller{ loop });
     }
-    else
+    else if (type == PollerType::POLL)
     {
         result.reset(new Poller{ loop });
     }
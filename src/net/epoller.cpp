@@ -29,7 +29,10 @@ static_assert(EPOLLERR == POLLERR, "EPOLLERR != POLLERR");
 Epoller::Epoller(EventLoop* loop)
     : PollerBase(loop),
       mEpollFd(::epoll_create1(EPOLL_CLOEXEC)),
-      mEpollEvents(kInitEventListSize)
+      mEpollEvents(kInitEventListSize),
+      mIsDeferred(false),
+      mInterests(),
+      mDirtyFds()
 {
     if (mEpollFd < 0)
     {
@@ -44,7 +47,8 @@ Epoller::~Epoller()
 
 TimeStamp Epoller::poll(int timeoutMs, ChannelList& activeChannels)
 {
-    LOG_TRACE << "total fd count = " << mChannels.size();
+    LOG_TRACE << "total fd count = " << channel_count();
+    flush_dirty();
     int numEvents = ::epoll_wait(mEpollFd, mEpollEvents.data(),
         static_cast<int>(mEpollEvents.size()),
         timeoutMs);
@@ -81,48 +85,30 @@ void Epoller::update_channel(Channel& channel)
 {
     PollerBase::assert_in_loop_thread();
     const int idx = channel.get_index();
+    const int fd = channel.get_fd();
 
-    LOG_TRACE << "fd = " << channel.get_fd()
+    LOG_TRACE << "fd = " << fd
         << ", events = " << channel.get_events()
         << ", index = " << idx;
 
-    if (idx == kNew || idx == kDeleted)
+    if (idx == kNew)
     {
-        // a new, add the channel
-        int fd = channel.get_fd();
-        if (idx == kNew)
-        {
-            assert(mChannels.find(fd) == mChannels.end());
-            mChannels[fd] = &channel;
-        }
-        else // idx == kDeleted
-        {
-            assert(mChannels.find(fd) != mChannels.end());
-            assert(mChannels.at(fd) == &channel);
-        }
-
-        channel.set_index(kAdded);
-        update(EPOLL_CTL_ADD, channel);
+        add_channel(channel);
     }
-    else // idx == kAdded
+    else // idx == kAdded || idx == kDeleted
     {
-        // a existing one
-        int fd = channel.get_fd();
-        assert(mChannels.find(fd) != mChannels.end());
-        assert(mChannels.at(fd) == &channel);
-        (void)fd;
+        assert(find_channel(fd) == &channel);
+    }
+    channel.set_index(channel.is_none_event() ? kDeleted : kAdded);
 
-        if (channel.is_none_event())
-        {
-            // DEL
-            channel.set_index(kDeleted);
-            update(EPOLL_CTL_DEL, channel);
-        }
-        else
-        {
-            // MOD
-            update(EPOLL_CTL_MOD, channel);
-        }
+    if (mIsDeferred)
+    {
+        // applied before the next epoll_wait
+        mark_dirty(fd);
+    }
+    else
+    {
+        apply(fd);
     }
 }
 
@@ -132,24 +118,46 @@ void Epoller::remove_channel(Channel& channel)
     int fd = channel.get_fd();
 
     LOG_TRACE << "remove fd = " << fd;
-    assert(mChannels.find(fd) != mChannels.end());
-    assert(mChannels.at(fd) == &channel);
+    assert(find_channel(fd) == &channel);
     assert(channel.is_none_event());
 
     int idx = channel.get_index();
     assert(idx == kAdded || idx == kDeleted);
-    std::size_t n = mChannels.erase(fd);
-    assert(n == 1);
-    (void)n;
+    (void)idx;
+    erase_channel(channel);
 
-    if (idx == kAdded)
+    // delete it now even if deferred, the fd may be closed and reused
+    Interest& interest = get_interest(fd);
+    if (interest.isAdded)
     {
-        update(EPOLL_CTL_DEL, channel);
+        update(EPOLL_CTL_DEL, channel, 0);
+        interest.isAdded = false;
+        interest.events = 0;
     }
 
     channel.set_index(kNew);
 }
 
+const char* Epoller::get_name() const
+{
+    return "epoll";
+}
+
+bool Epoller::supports_edge_triggered() const
+{
+    return true;
+}
+
+void Epoller::set_deferred_update(bool on)
+{
+    PollerBase::assert_in_loop_thread();
+    if (!on)
+    {
+        flush_dirty();
+    }
+    mIsDeferred = on;
+}
+
 void Epoller::fill_active_channels(int numEvents, 
     ChannelList& activeChannels) const
 {
@@ -158,23 +166,88 @@ void Epoller::fill_active_channels(int numEvents,
     for (int i = 0; i < numEvents; ++i)
     {
         Channel* channel = static_cast<Channel*>(mEpollEvents[i].data.ptr);
-#ifndef NDEBUG
-        int fd = channel->get_fd();
-        auto iter = mChannels.find(fd);
-        assert(iter != mChannels.end());
-        assert(iter->second == channel);
-#endif // NDEBUG
+        assert(find_channel(channel->get_fd()) == channel);
         channel->set_revents(mEpollEvents[i].events);
         activeChannels.push_back(channel);
     }
 }
 
-void Epoller::update(int op, Channel& channel)
+Epoller::Interest& Epoller::get_interest(int fd)
+{
+    assert(fd >= 0);
+    std::size_t index = static_cast<std::size_t>(fd);
+    if (index >= mInterests.size())
+    {
+        mInterests.resize(index + 1, Interest{ 0, false, false });
+    }
+
+    return mInterests[index];
+}
+
+void Epoller::mark_dirty(int fd)
+{
+    Interest& interest = get_interest(fd);
+    if (!interest.isDirty)
+    {
+        interest.isDirty = true;
+        mDirtyFds.push_back(fd);
+    }
+}
+
+void Epoller::flush_dirty()
+{
+    for (int fd : mDirtyFds)
+    {
+        apply(fd);
+    }
+    mDirtyFds.clear();
+}
+
+void Epoller::apply(int fd)
+{
+    Interest& interest = get_interest(fd);
+    interest.isDirty = false;
+
+    std::uint32_t events = 0;
+    Channel* channel = find_channel(fd);
+    if (channel != nullptr && !channel->is_none_event())
+    {
+        events = channel->get_events();
+        if (channel->is_edge_triggered())
+        {
+            events |= EPOLLET;
+        }
+    }
+
+    if (!interest.isAdded)
+    {
+        if (events != 0)
+        {
+            update(EPOLL_CTL_ADD, *channel, events);
+            interest.isAdded = true;
+        }
+    }
+    else if (events == 0)
+    {
+        // a removed channel is deleted at once, so the channel is here
+        assert(channel != nullptr);
+        update(EPOLL_CTL_DEL, *channel, 0);
+        interest.isAdded = false;
+    }
+    else if (events != interest.events)
+    {
+        update(EPOLL_CTL_MOD, *channel, events);
+    }
+
+    interest.events = events;
+}
+
+void Epoller::update(int op, Channel& channel, std::uint32_t events)
 {
     struct epoll_event evt;
     ::bzero(&evt, sizeof(evt));
 
-    evt.events = channel.get_events();
+    evt.events = events;
     evt.data.ptr = &channel;
 
     int fd = channel.get_fd();
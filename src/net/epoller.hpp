@@ -3,6 +3,8 @@
 #define ASUKA_EPOLLER_HPP
 
 #include <sys/epoll.h>
+
+#include <cstdint>
 #include <vector>
 
 #include "poller_base.hpp"
@@ -26,20 +28,45 @@ public:
 
     void remove_channel(Channel& channel) override;
 
+    const char* get_name() const override;
+
+    bool supports_edge_triggered() const override;
+
+    void set_deferred_update(bool on) override;
+
 private:
     static const std::size_t kInitEventListSize = 32;
     static const int kNew     = -1;
     static const int kAdded   = 1;
     static const int kDeleted = 2;
 
+    // the interest of a fd in the epoll instance
+    struct Interest
+    {
+        std::uint32_t events;   // 0 if not added
+        bool isAdded;
+        bool isDirty;           // the channel's events may differ
+    };
+
 private:
     void fill_active_channels(int numEvents, ChannelList& activeChannels) const;
-    void update(int op, Channel& channel);
+
+    Interest& get_interest(int fd);
+    void mark_dirty(int fd);
+    void flush_dirty();
+    // bring the interest of `fd` to its channel's, one epoll_ctl at most
+    void apply(int fd);
+
+    void update(int op, Channel& channel, std::uint32_t events);
     const char* operation_to_string(int op);
 
 private:
     int mEpollFd;
     std::vector<epoll_event> mEpollEvents;
+
+    bool mIsDeferred;
+    std::vector<Interest> mInterests;   // indexed by fd
+    std::vector<int> mDirtyFds;
 };
 
 } // namespace Net
@@ -4,12 +4,15 @@
 #include <sys/eventfd.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <functional>
 #include <thread>
 
 #include "../util/logger.hpp"
+#include "buffer_pool.hpp"
 #include "poller_base.hpp"
 #include "timer_queue.hpp"
+#include "timing_wheel.hpp"
 
 namespace Asuka
 {
@@ -49,24 +52,56 @@ struct IgnoreSignalPipe
 
 IgnoreSignalPipe gInitObj;
 
+// the counter is written by one thread, no read-modify-write needed
+void add_relaxed(std::atomic<std::uint64_t>& counter, std::uint64_t n)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + n, 
+                  std::memory_order_relaxed);
+}
+
+std::uint64_t elapsed_us(TimeStamp start, TimeStamp end)
+{
+    std::int64_t us = end.get_microseconds() - start.get_microseconds();
+    return us > 0 ? static_cast<std::uint64_t>(us) : 0;
+}
+
 } // unamed namespace
 
-EventLoop::EventLoop() 
+EventLoop::EventLoop()
+    : EventLoop(Config::instance().get_poller_type())
+{
+}
+
+EventLoop::EventLoop(PollerType type) 
     : mIsLoop(false),
       mIsQuit(false),
       mIsEventing(false),
       mIsCallingPendingFunction(false),
+      mIsWakeupPending(false),
       mIteration(0),
       mThreadId(std::this_thread::get_id()),
       mPollReturnTime(),
-      mPoller(PollerBase::create_default_poller(this)),
+      mPoller(PollerBase::create_poller(this, type)),
       mTimerQueue(new TimerQueue{this}),
+      mTimingWheel(),
       mWakeupFd(create_event_fd()),
       mWakeupChannel(new Channel{this, mWakeupFd}),
       mContext(),
-      mCurrentActiveChannel(nullptr)
-{
-    LOG_DEBUG << "EventLoop is created";
+      mBufferPool(new BufferPool{}),
+      mIsBufferPooling(false),
+      mIsEdgeTriggered(false),
+      mCurrentActiveChannel(nullptr),
+      mPendingFunctions(),
+      mStats(),
+      mMaxPendingTasks(0),
+      mMaxPendingMicroseconds(0),
+      mHasPendingBacklog(false),
+      mPollTimeoutMs(kPollTimeoutMs),
+      mBusyPollMicroseconds(0),
+      mLastActiveTime(),
+      mSlowHandlerUs(0)
+{
+    LOG_DEBUG << "EventLoop is created with " << mPoller->get_name();
     if (tEventLoopInThisThread)
     {
         LOG_FATAL << "current thread eventloop has existed";
@@ -77,6 +112,8 @@ EventLoop::EventLoop()
     }
 
     // always read the wakeup fd
+    mWakeupChannel->set_name("wakeup");
+    mWakeupChannel->set_priority(ChannelPriority::HIGH);
     mWakeupChannel->set_read_callback(
         std::bind(&EventLoop::handle_read, this));
     mWakeupChannel->enable_read();
@@ -124,6 +161,53 @@ Any& EventLoop::get_context()
     return mContext;
 }
 
+BufferPool& EventLoop::get_buffer_pool()
+{
+    return *mBufferPool;
+}
+
+void EventLoop::set_buffer_pooling(bool on)
+{
+    mIsBufferPooling = on;
+}
+
+bool EventLoop::is_buffer_pooling() const
+{
+    return mIsBufferPooling;
+}
+
+void EventLoop::set_task_budget(std::size_t maxTasks, 
+                                std::int64_t maxMicroseconds)
+{
+    mMaxPendingTasks = maxTasks;
+    mMaxPendingMicroseconds = maxMicroseconds;
+}
+
+void EventLoop::set_poll_timeout(int timeoutMs)
+{
+    mPollTimeoutMs = timeoutMs;
+}
+
+int EventLoop::get_poll_timeout() const
+{
+    return mPollTimeoutMs;
+}
+
+void EventLoop::set_busy_poll(std::int64_t microseconds)
+{
+    mBusyPollMicroseconds = microseconds;
+}
+
+void EventLoop::set_slow_handler_threshold(std::int64_t microseconds)
+{
+    mSlowHandlerUs = microseconds;
+}
+
+void EventLoop::record_slow_handler()
+{
+    add_relaxed(mStats.slowHandlers, 1);
+}
+
 EventLoop* EventLoop::get_event_loop_current_thread()
 {
     return tEventLoopInThisThread;
@@ -145,22 +229,120 @@ void EventLoop::handle_read()
     }
 }
 
-void EventLoop::pending_function()
+bool EventLoop::pending_function()
 {
-    std::vector<Function> functions;
     mIsCallingPendingFunction = true;
 
+    // clear before draining, a function queued from now on wakes up again
+    // exchange rather than store, so the functions queued before the
+    // wakeup was suppressed are visible here
+    mIsWakeupPending.exchange(false);
+
+    // only run the functions queued before, the functions queued by them
+    // run in the next iteration, queue_in_loop wakes up the loop for them
+    std::size_t count = mPendingFunctions.size();
+    bool hasBacklog = false;
+    if (mMaxPendingTasks > 0 && count > mMaxPendingTasks)
     {
-        std::lock_guard<std::mutex> lock{ mMutex };
-        functions.swap(mPendingFunctions);
+        count = mMaxPendingTasks;
+        hasBacklog = true;
     }
 
-    for (auto& function : functions)
+    std::int64_t deadline = 0;
+    if (mMaxPendingMicroseconds > 0)
     {
-        function();
+        deadline = TimeStamp::now().get_microseconds() 
+            + mMaxPendingMicroseconds;
+    }
+
+    std::uint64_t run = 0;
+    while (count > 0 && mPendingFunctions.consume(
+        [](Function& function) { function(); }))
+    {
+        --count;
+        ++run;
+
+        if (deadline > 0 && count > 0
+            && TimeStamp::now().get_microseconds() >= deadline)
+        {
+            hasBacklog = true;
+            break;
+        }
     }
+    add_relaxed(mStats.tasksRun, run);
 
     mIsCallingPendingFunction = false;
+    return hasBacklog;
+}
+
+int EventLoop::next_poll_timeout() const
+{
+    // do not wait if the budget left some functions
+    if (mHasPendingBacklog)
+    {
+        return 0;
+    }
+
+    // spin while events keep coming
+    if (mBusyPollMicroseconds > 0 && mLastActiveTime.is_valid()
+        && TimeStamp::now().get_microseconds() 
+            - mLastActiveTime.get_microseconds() < mBusyPollMicroseconds)
+    {
+        return 0;
+    }
+
+    // wake up for the next tick with timers
+    if (mTimingWheel)
+    {
+        int wheelTimeout = mTimingWheel->get_timeout(TimeStamp::now());
+        if (wheelTimeout >= 0 
+            && (mPollTimeoutMs < 0 || wheelTimeout < mPollTimeoutMs))
+        {
+            return wheelTimeout;
+        }
+    }
+
+    return mPollTimeoutMs;
+}
+
+void EventLoop::update_stats(TimeStamp pollStart, TimeStamp handlerEnd,
+                             TimeStamp pendingEnd)
+{
+    add_relaxed(mStats.iterations, 1);
+    add_relaxed(mStats.pollWaitUs, elapsed_us(pollStart, mPollReturnTime));
+    add_relaxed(mStats.handlerUs, elapsed_us(mPollReturnTime, handlerEnd));
+    add_relaxed(mStats.pendingUs, elapsed_us(handlerEnd, pendingEnd));
+    mStats.channels.store(mPoller->channel_count(), 
+                          std::memory_order_relaxed);
+
+    std::size_t events = mActiveChannels.size();
+    int bucket = 0;
+    while (events > 0 && bucket < kEventsBuckets - 1)
+    {
+        events >>= 1;
+        ++bucket;
+    }
+    add_relaxed(mStats.eventsHistogram[bucket], 1);
+}
+
+void EventLoop::sort_active_channels()
+{
+    if (mActiveChannels.size() < 2)
+    {
+        return;
+    }
+
+    // two partitions without allocating, the polled order is not kept,
+    // which doesn't matter in a class
+    auto normal = std::partition(mActiveChannels.begin(),
+        mActiveChannels.end(), [](const Channel* channel)
+        {
+            return channel->get_priority() == ChannelPriority::HIGH;
+        });
+    std::partition(normal, mActiveChannels.end(), [](const Channel* channel)
+        {
+            return channel->get_priority() == ChannelPriority::NORMAL;
+        });
 }
 
 void EventLoop::print_active_channels() const
@@ -183,14 +365,25 @@ void EventLoop::loop()
     while (!mIsQuit)
     {
         mActiveChannels.clear();
-        mPollReturnTime = mPoller->poll(kPollTimeoutMs, mActiveChannels);
+        TimeStamp pollStart = TimeStamp::now();
+        mPollReturnTime = mPoller->poll(next_poll_timeout(), mActiveChannels);
         ++mIteration;
+        if (!mActiveChannels.empty())
+        {
+            mLastActiveTime = mPollReturnTime;
+        }
+        sort_active_channels();
         if (Logger::get_level() <= LogLevel::TRACE)
         {
             print_active_channels();
         }
 
         mIsEventing = true;
+        if (mTimingWheel)
+        {
+            add_relaxed(mStats.wheelTimersFired, 
+                mTimingWheel->expire(mPollReturnTime));
+        }
         for (Channel* channel : mActiveChannels)
         {
             mCurrentActiveChannel = channel;
@@ -199,7 +392,9 @@ void EventLoop::loop()
 
         mCurrentActiveChannel = nullptr;
         mIsEventing = false;
-        pending_function();
+        TimeStamp handlerEnd = TimeStamp::now();
+        mHasPendingBacklog = pending_function();
+        update_stats(pollStart, handlerEnd, TimeStamp::now());
     }
 
     LOG_TRACE << "EventLoop " << this << " stop looping";
@@ -239,23 +434,54 @@ void EventLoop::run_in_loop(Function callback)
 
 void EventLoop::queue_in_loop(Function callback)
 {
-    {
-        std::lock_guard<std::mutex> lock{ mMutex };
-        mPendingFunctions.push_back(std::move(callback));
-    }
+    mPendingFunctions.push(std::move(callback));
 
     if (!is_in_loop_thread() || mIsCallingPendingFunction)
     {
-        wakeup();
+        // the first function after draining writes the wakeup fd,
+        // the following ones are run by the same wakeup
+        if (!mIsWakeupPending.exchange(true))
+        {
+            wakeup();
+        }
+        else
+        {
+            mStats.wakeupsSuppressed.fetch_add(1, std::memory_order_relaxed);
+        }
     }
 }
 
 std::size_t EventLoop::queue_size() const
 {
-    std::lock_guard<std::mutex> lock{ mMutex };
     return mPendingFunctions.size();
 }
 
+EventLoop::Stats EventLoop::get_stats() const
+{
+    Stats stats;
+    stats.iterations = mStats.iterations.load(std::memory_order_relaxed);
+    stats.pollWaitUs = mStats.pollWaitUs.load(std::memory_order_relaxed);
+    stats.handlerUs = mStats.handlerUs.load(std::memory_order_relaxed);
+    stats.pendingUs = mStats.pendingUs.load(std::memory_order_relaxed);
+    stats.tasksRun = mStats.tasksRun.load(std::memory_order_relaxed);
+    stats.wakeupsIssued = 
+        mStats.wakeupsIssued.load(std::memory_order_relaxed);
+    stats.wakeupsSuppressed = 
+        mStats.wakeupsSuppressed.load(std::memory_order_relaxed);
+    stats.timersFired = mTimerQueue->fired_count()
+        + mStats.wheelTimersFired.load(std::memory_order_relaxed);
+    stats.timerfdSets = mTimerQueue->timerfd_set_count();
+    stats.channels = mStats.channels.load(std::memory_order_relaxed);
+    stats.slowHandlers = mStats.slowHandlers.load(std::memory_order_relaxed);
+    for (int i = 0; i < kEventsBuckets; ++i)
+    {
+        stats.eventsHistogram[i] = 
+            mStats.eventsHistogram[i].load(std::memory_order_relaxed);
+    }
+
+    return stats;
+}
+
 TimerId EventLoop::run_at(TimeStamp time, TimerCallback callback)
 {
     return mTimerQueue->add_timer(std::move(callback), time, 0.0);
@@ -263,23 +489,95 @@ TimerId EventLoop::run_at(TimeStamp time, TimerCallback callback)
 
 TimerId EventLoop::run_after(double delay, TimerCallback callback)
 {
-    TimeStamp time = TimeStamp::now() + Duration{ delay };
+    TimeStamp time = TimeStamp::now() + Duration::from_seconds(delay);
+    if (mTimingWheel)
+    {
+        return mTimingWheel->add_timer(std::move(callback), time, 0.0);
+    }
     return run_at(time, std::move(callback));
 }
 
 TimerId EventLoop::run_interval(double interval, TimerCallback callback)
 {
-    TimeStamp time = TimeStamp::now() + Duration{ interval };
+    TimeStamp time = TimeStamp::now() + Duration::from_seconds(interval);
+    if (mTimingWheel)
+    {
+        return mTimingWheel->add_timer(std::move(callback), time, interval);
+    }
     return mTimerQueue->add_timer(std::move(callback), time, interval);
 }
 
 void EventLoop::cancel_timer(const TimerId& timerid)
 {
-    mTimerQueue->cancel(timerid);
+    if (!mTimingWheel)
+    {
+        mTimerQueue->cancel(timerid);
+        return;
+    }
+
+    // the timer is in either of them
+    run_in_loop([this, timerid]()
+    {
+        if (!mTimingWheel->cancel_in_loop(timerid))
+        {
+            mTimerQueue->cancel(timerid);
+        }
+    });
+}
+
+void EventLoop::reset_timer(const TimerId& timerid, double delay)
+{
+    TimeStamp when = TimeStamp::now() + Duration::from_seconds(delay);
+    run_in_loop([this, timerid, when]()
+    {
+        reschedule_timer_in_loop(timerid, when, false);
+    });
+}
+
+void EventLoop::extend_timer(const TimerId& timerid, double delay)
+{
+    TimeStamp when = TimeStamp::now() + Duration::from_seconds(delay);
+    run_in_loop([this, timerid, when]()
+    {
+        reschedule_timer_in_loop(timerid, when, true);
+    });
+}
+
+void EventLoop::reschedule_timer_in_loop(const TimerId& timerid, 
+                                         TimeStamp when, bool isExtending)
+{
+    // the timer is in either of them
+    if (mTimingWheel
+        && mTimingWheel->reschedule_in_loop(timerid, when, isExtending))
+    {
+        return;
+    }
+    mTimerQueue->reschedule_in_loop(timerid, when, isExtending);
+}
+
+void EventLoop::set_timer_slack(double seconds)
+{
+    assert_in_loop_thread();
+    mTimerQueue->set_slack(Duration::from_seconds(seconds));
+}
+
+void EventLoop::set_timing_wheel(double tickSeconds)
+{
+    assert(!mIsLoop);
+    assert(!mTimingWheel || mTimingWheel->size() == 0);
+    if (tickSeconds > 0.0)
+    {
+        mTimingWheel.reset(new TimingWheel{ this, tickSeconds });
+    }
+    else
+    {
+        mTimingWheel.reset();
+    }
 }
 
 void EventLoop::wakeup()
 {
+    mStats.wakeupsIssued.fetch_add(1, std::memory_order_relaxed);
     std::uint64_t one = 1;
     ssize_t n = ::write(mWakeupFd, &one, sizeof(one));
     if (n != sizeof(one))
@@ -308,6 +606,31 @@ void EventLoop::remove_channel(Channel& channel)
     mPoller->remove_channel(channel);
 }
 
+const char* EventLoop::get_poller_name() const
+{
+    return mPoller->get_name();
+}
+
+void EventLoop::set_edge_triggered(bool on)
+{
+    mIsEdgeTriggered = on && mPoller->supports_edge_triggered();
+    if (on && !mIsEdgeTriggered)
+    {
+        LOG_WARN << mPoller->get_name() << " doesn't support edge-triggered";
+    }
+}
+
+bool EventLoop::is_edge_triggered() const
+{
+    return mIsEdgeTriggered;
+}
+
+void EventLoop::set_deferred_update(bool on)
+{
+    assert_in_loop_thread();
+    mPoller->set_deferred_update(on);
+}
+
 bool EventLoop::has_channel(const Channel& channel) const
 {
     assert(channel.get_owner_loop() == this);
@@ -4,11 +4,12 @@
 
 #include <atomic>
 #include <memory>
-#include <mutex>
 #include <thread>
 #include <vector>
 
 #include "../util/any.hpp"
+#include "../util/config.hpp"
+#include "../util/mpsc_queue.hpp"
 #include "../util/noncopyable.hpp"
 #include "../util/time_stamp.hpp"
 #include "callback.hpp"
@@ -20,17 +21,22 @@ namespace Asuka
 namespace Net
 {
 
+class BufferPool;
 class Channel;
 class PollerBase;
 class TimerQueue;
+class TimingWheel;
 
 class EventLoop : Noncopyable
 {
 public:
-    using Function = std::function<void()>;
+    // move-only, small callables are stored without allocating
+    using Function = Task;
 
 public:
+    // the poller is chosen by the configuration file
     EventLoop();
+    explicit EventLoop(PollerType type);
     ~EventLoop();
 
     // must be called in same thread as creation of the object
@@ -54,26 +60,98 @@ public:
 
     std::size_t queue_size() const;
 
+    static const int kEventsBuckets = 8;
+
+    // statistics of the loop, see get_stats()
+    struct Stats
+    {
+        std::uint64_t iterations;
+        std::uint64_t pollWaitUs;       // time blocked in poll
+        std::uint64_t handlerUs;        // time in channel callbacks
+        std::uint64_t pendingUs;        // time in pending functions
+        std::uint64_t tasksRun;         // pending functions run
+        std::uint64_t wakeupsIssued;    // eventfd writes
+        std::uint64_t wakeupsSuppressed;// skipped, a wakeup was pending
+        std::uint64_t timersFired;
+        std::uint64_t timerfdSets;      // timerfd_settime calls
+        std::uint64_t channels;         // channels added to the poller
+        std::uint64_t slowHandlers;     // see set_slow_handler_threshold
+
+        // iterations by the number of active channels,
+        // bucket 0 is no event, bucket i is [2^(i-1), 2^i),
+        // the last bucket also counts the larger ones
+        std::uint64_t eventsHistogram[kEventsBuckets];
+    };
+
+    // always on, thread safe, the counters are read one by one,
+    // so they may be from different iterations
+    Stats get_stats() const;
+
     /// timers event
 
     // thread safe, call `callback` at `time`
     TimerId run_at(TimeStamp time, TimerCallback callback);
 
     // thread safe, call `callback` after `delay` seconds
+    // in the timing wheel if it is on
     TimerId run_after(double delay, TimerCallback callback);
 
     // thread safe, call `callback` every `interval` seconds
+    // in the timing wheel if it is on
     TimerId run_interval(double interval, TimerCallback callback);
 
     // thread safe
     void cancel_timer(const TimerId& timerid);
 
+    // thread safe, move the expiration of a timer to `delay` seconds
+    // from now, earlier or later, without allocating a timer, a refreshed
+    // deadline costs little, e.g. an idle timeout reset by each message
+    // no effect if the timer has fired, is running or has been canceled
+    void reset_timer(const TimerId& timerid, double delay);
+
+    // like reset_timer, but never moves the expiration earlier
+    void extend_timer(const TimerId& timerid, double delay);
+
+    // let the timers of the timer queue fire up to `seconds` late,
+    // the timerfd is set to the end of the slack bucket of the earliest
+    // timer, so the timers in a bucket fire together, and adding a timer
+    // to an armed bucket costs no timerfd_settime(2)
+    // 0 is precise, default is 0, must be called in the loop thread
+    void set_timer_slack(double seconds);
+
+    // keep the timers of run_after and run_interval in a timing wheel
+    // with ticks of `tickSeconds`, 1ms at least, adding and canceling
+    // are O(1), but a timer fires up to one tick late, it suits many
+    // timeouts that are often canceled, e.g. idle connections
+    // run_at always uses the precise timer queue
+    // default is off, must be called before loop() and any timer is added
+    void set_timing_wheel(double tickSeconds);
+
     // internal usage
     void wakeup();
     void update_channel(Channel& channel);
     void remove_channel(Channel& channel);
     bool has_channel(const Channel& channel) const;
 
+    // "poll", "epoll" or "io_uring"
+    const char* get_poller_name() const;
+
+    // if on, the connections of the loop use edge-triggered events,
+    // they read and write until EAGAIN and keep the write interest,
+    // so enabling and disabling writing costs no epoll_ctl(2)
+    // only epoll supports it, it stays off with other pollers
+    // default is off, must be called before any connection is assigned
+    void set_edge_triggered(bool on);
+    bool is_edge_triggered() const;
+
+    // if on, the interest changes of channels are applied right before
+    // the next poll, only the net change of a channel costs a syscall,
+    // e.g. enabling and then disabling writing in one iteration costs none
+    // a removed channel is still removed at once
+    // for epoll, io_uring always defers, poll(2) needs no syscall
+    // default is off, must be called in the loop thread
+    void set_deferred_update(bool on);
+
     void assert_in_loop_thread() const;
     bool is_in_loop_thread() const;
     bool is_event_handing() const;
@@ -82,12 +160,68 @@ public:
     const Any& get_context() const;
     Any& get_context();
 
+    // the read slab and storage blocks shared by connections of the loop
+    // only used in the loop thread
+    BufferPool& get_buffer_pool();
+
+    // if on, an idle connection gives its input buffer storage back 
+    // to the pool, default is off
+    // must be called before any connection is assigned to the loop
+    void set_buffer_pooling(bool on);
+    bool is_buffer_pooling() const;
+
+    // limit the pending functions run per iteration, 0 means no limit
+    // the left functions run in the next iteration, which polls without
+    // waiting, so a burst of queued functions does not delay the I/O
+    // must be called before loop() or in the loop thread
+    void set_task_budget(std::size_t maxTasks, std::int64_t maxMicroseconds);
+
+    // the longest time a poll blocks, default is 10s
+    // must be called before loop() or in the loop thread
+    void set_poll_timeout(int timeoutMs);
+    int get_poll_timeout() const;
+
+    // poll without blocking until no event happens for `microseconds`,
+    // then block again, it trades cpu for latency of waking up
+    // 0 is off, default is off
+    // must be called before loop() or in the loop thread
+    void set_busy_poll(std::int64_t microseconds);
+
+    // log a channel callback that runs at least `microseconds`, 
+    // with its fd, name and kind, 0 is off, default is off
+    // the timers of the timer queue are timed together as the read
+    // callback of the "timer" channel, pending functions and the timers
+    // of the timing wheel are not timed
+    // must be called before loop() or in the loop thread
+    void set_slow_handler_threshold(std::int64_t microseconds);
+
+    // inline, it is read for every channel event
+    std::int64_t get_slow_handler_threshold() const
+    {
+        return mSlowHandlerUs;
+    }
+
+    void record_slow_handler();     // used by channel
+
     static EventLoop* get_event_loop_current_thread();
 
 private:
     void abort_not_in_loop_thread() const;
     void handle_read();  // wake up
-    void pending_function();
+    // return true if functions are left because of the budget
+    bool pending_function();
+
+    // timeout of the next poll
+    int next_poll_timeout() const;
+
+    void reschedule_timer_in_loop(const TimerId& timerid, TimeStamp when,
+                                  bool isExtending);
+
+    void update_stats(TimeStamp pollStart, TimeStamp handlerEnd,
+                      TimeStamp pendingEnd);
+
+    // move the channels of higher priority to the front
+    void sort_active_channels();
 
     void print_active_channels() const; // DEBUG
 
@@ -96,6 +230,7 @@ private:
     std::atomic_bool mIsQuit;
     std::atomic_bool mIsEventing;
     std::atomic_bool mIsCallingPendingFunction;
+    std::atomic_bool mIsWakeupPending;
 
     std::uint64_t mIteration;
 
@@ -104,17 +239,52 @@ private:
 
     std::unique_ptr<PollerBase> mPoller;
     std::unique_ptr<TimerQueue> mTimerQueue;
+    std::unique_ptr<TimingWheel> mTimingWheel;     // nullptr if off
 
     int mWakeupFd;
     std::unique_ptr<Channel> mWakeupChannel;
 
     Any mContext;
 
+    std::unique_ptr<BufferPool> mBufferPool;
+    bool mIsBufferPooling;
+    bool mIsEdgeTriggered;
+
     std::vector<Channel*> mActiveChannels;
     Channel* mCurrentActiveChannel;
 
-    mutable std::mutex mMutex;
-    std::vector<Function> mPendingFunctions;  // Guarded by mMutex
+    // pushed by any thread, popped by the loop thread
+    MpscQueue<Function> mPendingFunctions;
+
+    // written by the loop thread only, except the wakeup counters
+    struct AtomicStats
+    {
+        std::atomic<std::uint64_t> iterations;
+        std::atomic<std::uint64_t> pollWaitUs;
+        std::atomic<std::uint64_t> handlerUs;
+        std::atomic<std::uint64_t> pendingUs;
+        std::atomic<std::uint64_t> tasksRun;
+        std::atomic<std::uint64_t> wakeupsIssued;
+        std::atomic<std::uint64_t> wakeupsSuppressed;
+        std::atomic<std::uint64_t> channels;
+        std::atomic<std::uint64_t> slowHandlers;
+        // the timers fired in the timing wheel, kept here as
+        // set_timing_wheel may replace the wheel
+        std::atomic<std::uint64_t> wheelTimersFired;
+        std::atomic<std::uint64_t> eventsHistogram[kEventsBuckets];
+    };
+
+    AtomicStats mStats;
+
+    std::size_t mMaxPendingTasks;
+    std::int64_t mMaxPendingMicroseconds;
+    bool mHasPendingBacklog;
+
+    int mPollTimeoutMs;
+    std::int64_t mBusyPollMicroseconds;
+    TimeStamp mLastActiveTime;  // the last poll returned events
+
+    std::int64_t mSlowHandlerUs;
 };
 
 } // namespace Net
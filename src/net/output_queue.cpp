@@ -0,0 +1,294 @@
+﻿#include "output_queue.hpp"
+
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+
+#include "../util/logger.hpp"
+
+namespace Asuka
+{
+
+namespace Net
+{
+
+const std::size_t OutputQueue::kChunkSize = 64 * 1024;
+const std::size_t OutputQueue::kMinChunkSize = 1024;
+
+OutputQueue::Chunk::Chunk(std::size_t size)
+    : buffer(new Buffer{ size }),
+      payload(),
+      fd(-1),
+      offset(0),
+      length(0)
+{
+}
+
+OutputQueue::Chunk::Chunk(Buffer&& data)
+    : buffer(new Buffer{ std::move(data) }),
+      payload(),
+      fd(-1),
+      offset(0),
+      length(0)
+{
+}
+
+OutputQueue::Chunk::Chunk(SharedPayload data, std::size_t off)
+    : buffer(),
+      payload(std::move(data)),
+      fd(-1),
+      offset(off),
+      length(0)
+{
+    assert(offset <= payload->size());
+}
+
+OutputQueue::Chunk::Chunk(int file, off_t off, std::size_t len)
+    : buffer(),
+      payload(),
+      fd(file),
+      offset(static_cast<std::size_t>(off)),
+      length(len)
+{
+    assert(fd >= 0);
+    assert(off >= 0);
+}
+
+const char* OutputQueue::Chunk::data() const
+{
+    assert(!is_file());
+    return buffer ? buffer->read_begin() : payload->data() + offset;
+}
+
+std::size_t OutputQueue::Chunk::size() const
+{
+    if (buffer)
+    {
+        return buffer->readable_bytes();
+    }
+
+    return is_file() ? length : payload->size() - offset;
+}
+
+bool OutputQueue::Chunk::writable() const
+{
+    return buffer && buffer->writable_bytes() > 0;
+}
+
+bool OutputQueue::Chunk::is_file() const
+{
+    return fd >= 0;
+}
+
+void OutputQueue::Chunk::retrieve(std::size_t len)
+{
+    assert(len <= size());
+    if (buffer)
+    {
+        buffer->retrieve(len);
+    }
+    else if (is_file())
+    {
+        offset += len;
+        length -= len;
+    }
+    else
+    {
+        offset += len;
+    }
+}
+
+OutputQueue::OutputQueue()
+    : mChunks(),
+      mReadableBytes(0)
+{
+}
+
+std::size_t OutputQueue::readable_bytes() const
+{
+    return mReadableBytes;
+}
+
+bool OutputQueue::empty() const
+{
+    return mReadableBytes == 0;
+}
+
+std::size_t OutputQueue::chunk_count() const
+{
+    return mChunks.size();
+}
+
+void OutputQueue::append(const StringView& sv)
+{
+    append(sv.data(), sv.size());
+}
+
+void OutputQueue::append(const void* data, std::size_t len)
+{
+    const char* str = static_cast<const char*>(data);
+    mReadableBytes += len;
+
+    while (len > 0)
+    {
+        if (mChunks.empty() || !mChunks.back().writable())
+        {
+            mChunks.emplace_back(next_chunk_size(len));
+        }
+
+        // only fill the free space of the chunk, 
+        // so the chunk is never resized or compacted
+        Buffer& chunk = *mChunks.back().buffer;
+        std::size_t n = std::min(len, chunk.writable_bytes());
+        chunk.append(str, n);
+        str += n;
+        len -= n;
+    }
+}
+
+std::size_t OutputQueue::next_chunk_size(std::size_t len) const
+{
+    // a small message gets a small chunk, the following chunks double
+    // up to kChunkSize, so a burst of small appends still makes few chunks
+    std::size_t size = kMinChunkSize;
+    if (!mChunks.empty() && mChunks.back().buffer)
+    {
+        size = std::min(kChunkSize, 2 * mChunks.back().buffer->size());
+    }
+
+    // a large message gets a chunk of its own size, rounded up
+    std::size_t rounded = (len + kMinChunkSize - 1) / kMinChunkSize 
+        * kMinChunkSize;
+    return std::max(size, rounded);
+}
+
+void OutputQueue::append(SharedPayload payload, std::size_t offset)
+{
+    assert(payload);
+    if (offset == payload->size())
+    {
+        return;
+    }
+
+    mChunks.emplace_back(std::move(payload), offset);
+    mReadableBytes += mChunks.back().size();
+}
+
+void OutputQueue::append(std::string&& str, std::size_t offset)
+{
+    append(std::make_shared<const std::string>(std::move(str)), offset);
+}
+
+void OutputQueue::append(Buffer&& buffer)
+{
+    if (buffer.readable_bytes() == 0)
+    {
+        return;
+    }
+
+    mChunks.emplace_back(std::move(buffer));
+    mReadableBytes += mChunks.back().size();
+}
+
+void OutputQueue::append_file(int fd, off_t offset, std::size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+
+    mChunks.emplace_back(fd, offset, len);
+    mReadableBytes += len;
+}
+
+void OutputQueue::retrieve(std::size_t len)
+{
+    assert(len <= mReadableBytes);
+    mReadableBytes -= len;
+
+    while (len > 0)
+    {
+        assert(!mChunks.empty());
+        Chunk& chunk = mChunks.front();
+        if (len < chunk.size())
+        {
+            chunk.retrieve(len);
+            break;
+        }
+
+        len -= chunk.size();
+        mChunks.pop_front();
+    }
+}
+
+void OutputQueue::retrieve_all()
+{
+    mChunks.clear();
+    mReadableBytes = 0;
+}
+
+ssize_t OutputQueue::write_fd(int fd, int& savedError)
+{
+    if (!mChunks.empty() && mChunks.front().is_file())
+    {
+        return send_file(fd, savedError);
+    }
+
+    struct iovec vec[kMaxIovecs];
+    int iovcnt = 0;
+
+    // gather the memory chunks before the first file region
+    for (auto iter = mChunks.begin(); 
+         iter != mChunks.end() && iovcnt < kMaxIovecs && !iter->is_file(); 
+         ++iter)
+    {
+        vec[iovcnt].iov_base = const_cast<char*>(iter->data());
+        vec[iovcnt].iov_len  = iter->size();
+        ++iovcnt;
+    }
+
+    const ssize_t n = ::writev(fd, vec, iovcnt);
+    if (n < 0)
+    {
+        savedError = errno;
+    }
+    else
+    {
+        retrieve(static_cast<std::size_t>(n));
+    }
+
+    return n;
+}
+
+ssize_t OutputQueue::send_file(int fd, int& savedError)
+{
+    Chunk& chunk = mChunks.front();
+    assert(chunk.is_file());
+
+    off_t offset = static_cast<off_t>(chunk.offset);
+    const ssize_t n = ::sendfile(fd, chunk.fd, &offset, chunk.length);
+    if (n < 0)
+    {
+        savedError = errno;
+    }
+    else if (n == 0)
+    {
+        // reach the end of file before the region is written
+        LOG_ERROR << "OutputQueue::send_file file fd = " << chunk.fd
+            << " is truncated, drop " << chunk.length << " bytes";
+        retrieve(chunk.length);
+    }
+    else
+    {
+        retrieve(static_cast<std::size_t>(n));
+    }
+
+    return n;
+}
+
+} // namespace Net
+
+} // namespace Asuka
\ No newline at end of file
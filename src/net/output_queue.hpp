@@ -0,0 +1,111 @@
+#pragma once
+#ifndef ASUKA_OUTPUT_QUEUE_HPP
+#define ASUKA_OUTPUT_QUEUE_HPP
+
+#include <sys/types.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "../util/noncopyable.hpp"
+#include "../util/string_view.hpp"
+#include "buffer.hpp"
+
+namespace Asuka
+{
+
+namespace Net
+{
+
+// immutable payload shared by many connections, e.g. broadcast
+using SharedPayload = std::shared_ptr<const std::string>;
+
+// the output queue of TcpConnection
+// it is a chain of chunks, the queued bytes are never moved
+// when appending, and many chunks are flushed by a single writev(2)
+// a chunk is either a Buffer holding copied bytes,
+// a reference of a SharedPayload which is written without copying,
+// or a file region which is written by sendfile(2)
+//
+// +---------+    +---------+    +---------+
+// | chunk 0 | -> | chunk 1 | -> | chunk 2 | -> ...
+// +---------+    +---------+    +---------+
+//   front                         back (appending)
+class OutputQueue : Noncopyable
+{
+public:
+    OutputQueue();
+
+    // the number of bytes which have not been written
+    std::size_t readable_bytes() const;
+    bool empty() const;
+
+    std::size_t chunk_count() const;
+
+    // copy data at the back of the queue
+    void append(const StringView& sv);
+    void append(const void* data, std::size_t len);
+
+    // queue the payload by reference, start writing at `offset`
+    void append(SharedPayload payload, std::size_t offset = 0);
+
+    // take over the storage without copying, start writing at `offset`
+    void append(std::string&& str, std::size_t offset = 0);
+    void append(Buffer&& buffer);
+
+    // queue [offset, offset + len) of the file `fd`
+    // the caller still owns `fd`, it must be open until the region is written
+    void append_file(int fd, off_t offset, std::size_t len);
+
+    // drop len bytes from the front of the queue
+    void retrieve(std::size_t len);
+    void retrieve_all();
+
+    // write the queued data into fd directly by writev(2),
+    // or sendfile(2) if a file region is at the front
+    // on success, return the number of bytes written is returned
+    // on error, return -1 and `savedError` is set appropriately
+    ssize_t write_fd(int fd, int& savedError);
+
+private:
+    // the max number of chunks gathered by a writev(2)
+    static const int kMaxIovecs = 64;
+    // the size of a new chunk is in [kMinChunkSize, kChunkSize],
+    // unless the message is larger
+    static const std::size_t kChunkSize;
+    static const std::size_t kMinChunkSize;
+
+    struct Chunk
+    {
+        explicit Chunk(std::size_t size);
+        explicit Chunk(Buffer&& data);
+        Chunk(SharedPayload data, std::size_t off);
+        Chunk(int file, off_t off, std::size_t len);
+
+        const char* data() const;
+        std::size_t size() const;
+        bool writable() const;
+        bool is_file() const;
+        void retrieve(std::size_t len);
+
+        std::unique_ptr<Buffer> buffer;     // copied bytes
+        SharedPayload payload;              // shared bytes
+        int fd;                             // file region, -1 if not a file
+        std::size_t offset;                 // read offset of `payload` or file
+        std::size_t length;                 // bytes left in the file region
+    };
+
+    std::size_t next_chunk_size(std::size_t len) const;
+    ssize_t send_file(int fd, int& savedError);
+
+private:
+    std::deque<Chunk> mChunks;
+    std::size_t mReadableBytes;
+};
+
+} // namespace Net
+
+} // namespace Asuka
+
+#endif // ASUKA_OUTPUT_QUEUE_HPP
\ No newline at end of file
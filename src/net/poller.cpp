@@ -55,7 +55,7 @@ void Poller::update_channel(Channel& channel)
     if (channel.get_index() < 0)
     {
         // a new one, add the pollfd
-        assert(mChannels.find(channel.get_fd()) == mChannels.end());
+        assert(find_channel(channel.get_fd()) == nullptr);
         struct pollfd pfd;
         pfd.fd = channel.get_fd();
         pfd.events = static_cast<short>(channel.get_events());
@@ -65,13 +65,12 @@ void Poller::update_channel(Channel& channel)
         assert(!mPollfdList.empty());
         int idx = static_cast<int>(mPollfdList.size() - 1);
         channel.set_index(idx);
-        mChannels[pfd.fd] = &channel;
+        add_channel(channel);
     }
     else
     {
         // update existing one
-        assert(mChannels.find(channel.get_fd()) != mChannels.end());
-        assert(mChannels.at(channel.get_fd()) == &channel);
+        assert(find_channel(channel.get_fd()) == &channel);
         std::size_t idx = channel.get_index();
         assert(idx < mPollfdList.size());
 
@@ -94,8 +93,7 @@ void Poller::remove_channel(Channel& channel)
     PollerBase::assert_in_loop_thread();
 
     LOG_TRACE << "fd = " << channel.get_fd();
-    assert(mChannels.find(channel.get_fd()) != mChannels.end());
-    assert(mChannels.at(channel.get_fd()) == &channel);
+    assert(find_channel(channel.get_fd()) == &channel);
     assert(channel.is_none_event());
 
     int idx = channel.get_index();
@@ -105,9 +103,7 @@ void Poller::remove_channel(Channel& channel)
     assert(pfd.events == static_cast<short>(channel.get_events()));
     (void)pfd;
 
-    std::size_t n = mChannels.erase(channel.get_fd());
-    assert(n == 1);
-    (void)n;
+    erase_channel(channel);
 
     // remove pollfd from `mPollfdList`
     if (idx == static_cast<int>(mPollfdList.size() - 1))
@@ -126,11 +122,16 @@ void Poller::remove_channel(Channel& channel)
         }
 
         // swap idx
-        mChannels[fdAtEnd]->set_index(idx);
+        find_channel(fdAtEnd)->set_index(idx);
         mPollfdList.pop_back();
     }
 }
 
+const char* Poller::get_name() const
+{
+    return "poll";
+}
+
 void Poller::fill_active_channels(int numEvents, 
     ChannelList& activeChannels) const
 {
@@ -139,9 +140,8 @@ void Poller::fill_active_channels(int numEvents,
         if (pfd->revents > 0)
         {
             --numEvents;
-            auto iter = mChannels.find(pfd->fd);
-            assert(iter != mChannels.end());
-            Channel* channel = iter->second;
+            Channel* channel = find_channel(pfd->fd);
+            assert(channel != nullptr);
             assert(channel->get_fd() == pfd->fd);
             channel->set_revents(pfd->revents);
             activeChannels.push_back(channel);
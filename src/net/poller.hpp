@@ -27,6 +27,8 @@ public:
 
     void remove_channel(Channel& channel) override;
 
+    const char* get_name() const override;
+
 private:
     void fill_active_channels(int numEvents, ChannelList& activeChannels) const;
 
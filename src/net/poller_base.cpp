@@ -10,7 +10,9 @@ namespace Net
 {
 
 PollerBase::PollerBase(EventLoop* loop)
-    : mLoop(loop)
+    : mLoop(loop),
+      mChannels(),
+      mChannelCount(0)
 {
 }
 
@@ -21,9 +23,22 @@ PollerBase::~PollerBase()
 bool PollerBase::has_channel(const Channel& channel) const
 {
     assert_in_loop_thread();
-    auto iter = mChannels.find(channel.get_fd());
 
-    return iter != mChannels.end() && iter->second == &channel;
+    return find_channel(channel.get_fd()) == &channel;
+}
+
+bool PollerBase::supports_edge_triggered() const
+{
+    return false;
+}
+
+void PollerBase::set_deferred_update(bool)
+{
+}
+
+std::size_t PollerBase::channel_count() const
+{
+    return mChannelCount;
 }
 
 void PollerBase::assert_in_loop_thread() const
@@ -31,6 +46,31 @@ void PollerBase::assert_in_loop_thread() const
     return mLoop->assert_in_loop_thread();
 }
 
+void PollerBase::add_channel(Channel& channel)
+{
+    int fd = channel.get_fd();
+    assert(fd >= 0);
+    assert(find_channel(fd) == nullptr);
+
+    std::size_t index = static_cast<std::size_t>(fd);
+    if (index >= mChannels.size())
+    {
+        mChannels.resize(index + 1, nullptr);
+    }
+
+    mChannels[index] = &channel;
+    ++mChannelCount;
+}
+
+void PollerBase::erase_channel(Channel& channel)
+{
+    int fd = channel.get_fd();
+    assert(find_channel(fd) == &channel);
+
+    mChannels[static_cast<std::size_t>(fd)] = nullptr;
+    --mChannelCount;
+}
+
 } // namespace Net
 
 } // namespace Asuka
\ No newline at end of file
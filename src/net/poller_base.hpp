@@ -2,10 +2,11 @@
 #ifndef ASUKA_POLLER_BASE
 #define ASUKA_POLLER_BASE
 
-#include <map>
+#include <cstddef>
 #include <memory>
 #include <vector>
 
+#include "../util/config.hpp"
 #include "../util/noncopyable.hpp"
 #include "../util/time_stamp.hpp"
 
@@ -44,17 +45,45 @@ public:
 
     bool has_channel(const Channel& channel) const;
 
+    // "poll", "epoll" or "io_uring"
+    virtual const char* get_name() const = 0;
+
+    // whether Channel::is_edge_triggered is respected
+    virtual bool supports_edge_triggered() const;
+
+    // see EventLoop::set_deferred_update, ignored by default
+    virtual void set_deferred_update(bool on);
+
+    // the number of channels added
+    std::size_t channel_count() const;
+
+    // the poller of `use` in the configuration file
     static std::unique_ptr<PollerBase> create_default_poller(EventLoop* loop);
 
+    // fall back to epoll if io_uring is not supported
+    static std::unique_ptr<PollerBase> create_poller(EventLoop* loop,
+                                                     PollerType type);
+
     void assert_in_loop_thread() const;
 
 protected:
-    // <fd, Channel*>
-    using ChannelMap = std::map<int, Channel*>;
-    ChannelMap mChannels;
+    // nullptr if no channel of `fd` is added
+    Channel* find_channel(int fd) const
+    {
+        std::size_t index = static_cast<std::size_t>(fd);
+        return index < mChannels.size() ? mChannels[index] : nullptr;
+    }
+
+    void add_channel(Channel& channel);
+    void erase_channel(Channel& channel);
 
 private:
     EventLoop* mLoop;
+
+    // indexed by fd, fds are small and reused from the lowest,
+    // so a lookup is an index instead of a tree search
+    std::vector<Channel*> mChannels;
+    std::size_t mChannelCount;
 };
 
 } // namespace Net
@@ -151,7 +151,8 @@ int Socket::accept(IpPort& peeraddr)
     ::bzero(&addr6, addrlen);
 
     sockaddr* addr = reinterpret_cast<sockaddr*>(&addr6);
-    int connfd = ::accept(mSockfd, addr, &addrlen);
+    int connfd = ::accept4(mSockfd, addr, &addrlen, 
+        SOCK_NONBLOCK | SOCK_CLOEXEC);
 
     if (connfd >= 0)
     {
@@ -232,6 +233,22 @@ void Socket::set_reuseport(int optval)
 #endif // SO_REUSEPORT
 }
 
+void Socket::set_busy_poll(int microseconds)
+{
+#ifdef SO_BUSY_POLL
+    if (::setsockopt(mSockfd, SOL_SOCKET, SO_BUSY_POLL,
+        &microseconds, static_cast<socklen_t>(sizeof(microseconds))) == -1)
+    {
+        LOG_SYSERROR << "setsockopt SO_BUSY_POLL error";
+    }
+#else 
+    if (microseconds)
+    {
+        LOG_SYSERROR << "SO_BUSY_POLL is not support";
+    }
+#endif // SO_BUSY_POLL
+}
+
 } // namespace Net
 
 } // namespace Asuka
\ No newline at end of file
@@ -50,6 +50,10 @@ public:
 
     // `optval`: 1 is on, 0 is off
     void set_reuseport(int optval);
+
+    // busy poll the device queue for `microseconds` on blocking reads
+    // and polls, 0 is off, it needs CAP_NET_ADMIN to raise the value
+    void set_busy_poll(int microseconds);
 private:
     const int mSockfd;
 };
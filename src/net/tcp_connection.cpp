@@ -1,16 +1,21 @@
 ﻿#include "tcp_connection.hpp"
 
 #include <netinet/tcp.h>
+#include <sys/sendfile.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
+#include <climits>
 #include <functional>
+#include <vector>
 
 #include "../util/logger.hpp"
 #include "../util/string_view.hpp"
 #include "../util/weak_callback.hpp"
 #include "buffer.hpp"
+#include "buffer_pool.hpp"
 #include "channel.hpp"
 #include "event_loop.hpp"
 #include "socket.hpp"
@@ -21,6 +26,40 @@ namespace Asuka
 namespace Net
 {
 
+namespace
+{
+
+// the pieces of send(initializer_list) gathered on the stack,
+// more use a heap array of iovec
+const int kMaxGatherIovecs = 16;
+
+// adaptive read size
+const std::size_t kMinReadSize  = 512;
+const std::size_t kInitReadSize = 1024;
+const std::size_t kMaxReadSize  = 256 * 1024;
+const int kMaxShortReads = 2;
+
+std::string gather(const struct iovec* iov, int iovcnt)
+{
+    std::size_t len = 0;
+    for (int i = 0; i < iovcnt; ++i)
+    {
+        len += iov[i].iov_len;
+    }
+
+    std::string message;
+    message.reserve(len);
+    for (int i = 0; i < iovcnt; ++i)
+    {
+        message.append(static_cast<const char*>(iov[i].iov_base),
+            iov[i].iov_len);
+    }
+
+    return message;
+}
+
+} // unamed namespace
+
 void default_connection_callback(const TcpConnectionPtr& conn)
 {
     LOG_TRACE << conn->get_local_address().get_ipport() << " -> "
@@ -49,8 +88,17 @@ TcpConnection::TcpConnection(EventLoop* loop,
       mChannel(new Channel{mLoop, sockfd}),
       mLocalAddr(localAddr),
       mPeerAddr(peerAddr), 
-      mHighWaterMark(60 * 1024 * 1024)
-{
+      mHighWaterMark(60 * 1024 * 1024),
+      mReadSize(kInitReadSize),
+      mReadBudget(0),
+      mShortReads(0),
+      mReadStats(),
+      // hold no input memory until data arrives if pooling
+      mInputBuffer(mLoop->is_buffer_pooling() 
+          ? Buffer{ Buffer::NoStorage{} } : Buffer{})
+{
+    mChannel->set_name(mName.c_str());     // mName outlives mChannel
+    mChannel->set_edge_triggered(mLoop->is_edge_triggered());
     mChannel->set_read_callback(std::bind(&TcpConnection::handle_read, 
         this, std::placeholders::_1));
     mChannel->set_write_callback(std::bind(&TcpConnection::handle_write,
@@ -137,6 +185,11 @@ void TcpConnection::send(const StringView& message)
     }
 }
 
+void TcpConnection::send(const char* message)
+{
+    send(StringView{ message });
+}
+
 void TcpConnection::send(Buffer& message)
 {
     if (mStatus == kConnected)
@@ -147,11 +200,120 @@ void TcpConnection::send(Buffer& message)
             message.retrieve_all();
         }
         else
+        {
+            Buffer tmp;
+            tmp.swap(message);
+            send(std::move(tmp));
+        }
+    }
+}
+
+void TcpConnection::send(std::string&& message)
+{
+    if (mStatus == kConnected)
+    {
+        if (mLoop->is_in_loop_thread())
+        {
+            send_in_loop(std::move(message));
+        }
+        else
         {
             mLoop->run_in_loop(std::bind(
-                [](std::string str, TcpConnectionPtr ptr)
-                { ptr->send_in_loop(str.data(), str.size()); },
-                    message.retrieve_all_as_string(), shared_from_this())); // MOD
+                [](std::string& str, TcpConnectionPtr ptr)
+                { ptr->send_in_loop(std::move(str)); },
+                    std::move(message), shared_from_this()));
+        }
+    }
+}
+
+void TcpConnection::send(Buffer&& message)
+{
+    if (mStatus == kConnected)
+    {
+        if (mLoop->is_in_loop_thread())
+        {
+            send_in_loop(std::move(message));
+        }
+        else
+        {
+            mLoop->run_in_loop(std::bind(
+                [](Buffer& buf, TcpConnectionPtr ptr)
+                { ptr->send_in_loop(std::move(buf)); },
+                    std::move(message), shared_from_this()));
+        }
+    }
+}
+
+void TcpConnection::send(const struct iovec* iov, int iovcnt)
+{
+    if (mStatus == kConnected)
+    {
+        if (mLoop->is_in_loop_thread())
+        {
+            send_in_loop(iov, iovcnt);
+        }
+        else
+        {
+            // caller's memory may be gone, gather the pieces once
+            // and move them into the loop
+            send(gather(iov, iovcnt));
+        }
+    }
+}
+
+void TcpConnection::send(std::initializer_list<StringView> messages)
+{
+    struct iovec stackVec[kMaxGatherIovecs];
+    std::vector<struct iovec> heapVec;
+    struct iovec* vec = stackVec;
+    if (messages.size() > static_cast<std::size_t>(kMaxGatherIovecs))
+    {
+        // only the iovecs are on the heap, the pieces are not copied
+        heapVec.resize(messages.size());
+        vec = heapVec.data();
+    }
+
+    int iovcnt = 0;
+    for (const StringView& message : messages)
+    {
+        vec[iovcnt].iov_base = const_cast<char*>(message.data());
+        vec[iovcnt].iov_len  = message.size();
+        ++iovcnt;
+    }
+
+    send(vec, iovcnt);
+}
+
+void TcpConnection::send_file(int fd, off_t offset, std::size_t len)
+{
+    if (mStatus == kConnected)
+    {
+        if (mLoop->is_in_loop_thread())
+        {
+            send_file_in_loop(fd, offset, len);
+        }
+        else
+        {
+            mLoop->run_in_loop(std::bind(&TcpConnection::send_file_in_loop,
+                shared_from_this(), fd, offset, len));
+        }
+    }
+}
+
+void TcpConnection::send(SharedPayload message)
+{
+    if (mStatus == kConnected)
+    {
+        if (mLoop->is_in_loop_thread())
+        {
+            send_in_loop(std::move(message));
+        }
+        else
+        {
+            mLoop->run_in_loop(std::bind(
+                [](SharedPayload payload, TcpConnectionPtr ptr)
+                { ptr->send_in_loop(std::move(payload)); },
+                    std::move(message), shared_from_this()));
         }
     }
 }
@@ -197,6 +359,17 @@ void TcpConnection::set_tcp_no_delay()
     mSocket->set_no_delay(1);
 }
 
+void TcpConnection::set_busy_poll(int microseconds)
+{
+    mSocket->set_busy_poll(microseconds);
+}
+
+void TcpConnection::set_priority(ChannelPriority priority)
+{
+    mLoop->assert_in_loop_thread();
+    mChannel->set_priority(priority);
+}
+
 void TcpConnection::start_read()
 {
     mLoop->run_in_loop(std::bind(&TcpConnection::start_read_in_loop, this));
@@ -212,6 +385,21 @@ bool TcpConnection::is_reading() const
     return mIsReading;
 }
 
+const TcpConnection::ReadStats& TcpConnection::get_read_stats() const
+{
+    return mReadStats;
+}
+
+std::size_t TcpConnection::get_read_size() const
+{
+    return mReadSize;
+}
+
+void TcpConnection::set_read_budget(std::size_t bytes)
+{
+    mReadBudget = bytes;
+}
+
 void TcpConnection::set_context(const Any& context)
 {
     mContext = context;
@@ -257,9 +445,9 @@ Buffer& TcpConnection::get_input_buffer()
     return mInputBuffer;
 }
 
-Buffer& TcpConnection::get_output_buffer()
+OutputQueue& TcpConnection::get_output_queue()
 {
-    return mOutputBuffer;
+    return mOutputQueue;
 }
 
 void TcpConnection::connect_established()
@@ -269,6 +457,11 @@ void TcpConnection::connect_established()
     set_status(kConnected);
     mChannel->tie(shared_from_this());
     mChannel->enable_read();
+    if (mChannel->is_edge_triggered())
+    {
+        // the write interest stays, it is reported when writable again
+        mChannel->enable_write();
+    }
 
     mConnectionCallback(shared_from_this());
 }
@@ -289,22 +482,127 @@ void TcpConnection::connect_destroy()
 void TcpConnection::handle_read(TimeStamp receivedTime)
 {
     mLoop->assert_in_loop_thread();
+    BufferPool& pool = mLoop->get_buffer_pool();
+    const bool pooling = mLoop->is_buffer_pooling();
+    if (pooling && !mInputBuffer.has_storage())
+    {
+        mInputBuffer.adopt_storage(pool.acquire());
+    }
+
+    ++mReadStats.events;
+    const bool edge = mChannel->is_edge_triggered();
+    bool isBudgetHit = false;
+    std::size_t total = 0;
+    ssize_t n = 0;
     int saveErrno = 0;
-    ssize_t n = mInputBuffer.read_fd(mChannel->get_fd(), saveErrno);
-    if (n > 0)
+    for (;;)
+    {
+        // a pooled block is not grown for the read size, the slab takes
+        // the rest of a large read, and only the bytes read are copied
+        std::size_t readSize = mReadSize;
+        if (pooling)
+        {
+            readSize = std::min(readSize, 
+                BufferPool::kBlockSize - mInputBuffer.get_prepend_size());
+        }
+        mInputBuffer.ensure_writable_bytes(readSize);
+        // read_fd only uses the slab if the buffer is smaller than it
+        const std::size_t writable = mInputBuffer.writable_bytes();
+        const std::size_t capacity = writable < pool.get_slab_size() 
+            ? writable + pool.get_slab_size() : writable;
+
+        n = mInputBuffer.read_fd(mChannel->get_fd(), saveErrno,
+            pool.get_slab(), pool.get_slab_size());
+        ++mReadStats.reads;
+        if (n <= 0)
+        {
+            break;
+        }
+
+        mReadStats.bytes += static_cast<std::size_t>(n);
+        total += static_cast<std::size_t>(n);
+        adjust_read_size(static_cast<std::size_t>(n));
+
+        // a short read means the socket is drained,
+        // data arriving later is reported again even if edge-triggered
+        if (static_cast<std::size_t>(n) < capacity)
+        {
+            break;
+        }
+
+        // the rest is reported again if level-triggered, but not if
+        // edge-triggered, so it reads until EAGAIN unless a budget is set
+        if (mReadBudget > 0 ? total >= mReadBudget : !edge)
+        {
+            isBudgetHit = edge;
+            break;
+        }
+    }
+
+    if (total > 0)
     {
         mMessageCallback(shared_from_this(), mInputBuffer, receivedTime);
     }
-    else if (n == 0)
+
+    if (isBudgetHit)
+    {
+        // continue after the other channels and pending functions,
+        // the rest is received then, not at the poll return time
+        mLoop->queue_in_loop(std::bind([](const TcpConnectionPtr& conn)
+            {
+                if (conn->mChannel->is_reading())
+                {
+                    conn->handle_read(TimeStamp::now());
+                }
+            }, shared_from_this()));
+    }
+
+    if (n == 0)
     {
         handle_close();
     }
-    else
+    else if (n < 0 && saveErrno != EAGAIN && saveErrno != EWOULDBLOCK)
     {
         errno = saveErrno;
         LOG_SYSERROR << "TcpConnection::handle_read";
         handle_error();
     }
+
+    // only the connection with a partial message retains the storage
+    if (pooling && mInputBuffer.has_storage() 
+        && mInputBuffer.readable_bytes() == 0)
+    {
+        pool.release(mInputBuffer.release_storage());
+    }
+    // without pooling, the storage grown for a large read is freed
+    // once it is drained and the read size has dropped
+    else if (!pooling && mInputBuffer.readable_bytes() == 0
+             && mInputBuffer.writable_bytes() > 2 * mReadSize)
+    {
+        mInputBuffer.shrink(mReadSize);
+    }
+}
+
+void TcpConnection::adjust_read_size(std::size_t n)
+{
+    if (n >= mReadSize)
+    {
+        mReadSize = std::min(mReadSize * 2, kMaxReadSize);
+        mShortReads = 0;
+    }
+    else if (n < mReadSize / 2)
+    {
+        // shrink only if the reads are short for a while
+        if (++mShortReads >= kMaxShortReads)
+        {
+            mReadSize = std::max(mReadSize / 2, kMinReadSize);
+            mShortReads = 0;
+        }
+    }
+    else
+    {
+        mShortReads = 0;
+    }
 }
 
 void TcpConnection::handle_write()
@@ -312,30 +610,42 @@ void TcpConnection::handle_write()
     mLoop->assert_in_loop_thread();
     if (mChannel->is_writing())
     {
-        std::size_t n = ::write(mChannel->get_fd(),
-            mOutputBuffer.read_begin(), mOutputBuffer.readable_bytes());
-        if (n > 0)
+        if (mOutputQueue.empty())
         {
-            mOutputBuffer.retrieve(n);
-            if (mOutputBuffer.readable_bytes() == 0)    // write completely
-            {
-                mChannel->disable_write();
-                if (mWriteCompleteCallback)
-                {
-                    mLoop->queue_in_loop(std::bind(
-                        mWriteCompleteCallback, shared_from_this()));
-                }
-
-                if (mStatus == kIsDisConnecting)
-                {
-                    shutdown_in_loop();
-                }   
-            }
+            return;     // edge-triggered, nothing queued
         }
-        else    // n <= 0
+
+        int saveErrno = 0;
+        ssize_t n = 0;
+        do
+        {
+            n = mOutputQueue.write_fd(mChannel->get_fd(), saveErrno);
+            // edge-triggered reports writable only after EAGAIN
+        } while (n >= 0 && mChannel->is_edge_triggered() 
+                 && !mOutputQueue.empty());
+
+        if (n < 0 && saveErrno != EAGAIN && saveErrno != EWOULDBLOCK)
         {
+            errno = saveErrno;
             LOG_SYSERROR << "TcpConnection::handle_write";
         }
+        else if (mOutputQueue.empty())    // write completely
+        {
+            if (!mChannel->is_edge_triggered())
+            {
+                mChannel->disable_write();
+            }
+            if (mWriteCompleteCallback)
+            {
+                mLoop->queue_in_loop(std::bind(
+                    mWriteCompleteCallback, shared_from_this()));
+            }
+
+            if (mStatus == kIsDisConnecting)
+            {
+                shutdown_in_loop();
+            }   
+        }
     }
     else  // !is_writing
     {
@@ -368,6 +678,14 @@ void TcpConnection::handle_error()
 }
 
 void TcpConnection::send_in_loop(const void* data, std::size_t len)
+{
+    struct iovec vec;
+    vec.iov_base = const_cast<void*>(data);
+    vec.iov_len  = len;
+    send_in_loop(&vec, 1);
+}
+
+void TcpConnection::send_in_loop(const struct iovec* iov, int iovcnt)
 {
     mLoop->assert_in_loop_thread();
     if (mStatus == kDisConnected)
@@ -376,30 +694,148 @@ void TcpConnection::send_in_loop(const void* data, std::size_t len)
         return;
     }
 
-    ssize_t nwrote = 0;
-    size_t remaining = len;
+    std::size_t len = 0;
+    for (int i = 0; i < iovcnt; ++i)
+    {
+        len += iov[i].iov_len;
+    }
+
     bool faultError = false;
+    std::size_t nwrote = write_directly(iov, iovcnt, len, faultError);
+    assert(nwrote <= len);
 
-    // if output queue is empty, try writing directly
-    if (!mChannel->is_writing() && mOutputBuffer.readable_bytes() == 0)
+    if (!faultError && nwrote < len)
     {
-        nwrote = ::write(mChannel->get_fd(), data, len);
-        if (nwrote < 0)     // error
+        // only copy the unwritten tail
+        std::size_t oldLen = mOutputQueue.readable_bytes();
+        std::size_t skip = nwrote;
+        for (int i = 0; i < iovcnt; ++i)
+        {
+            if (skip >= iov[i].iov_len)
+            {
+                skip -= iov[i].iov_len;
+                continue;
+            }
+
+            mOutputQueue.append(static_cast<const char*>(iov[i].iov_base) + skip,
+                iov[i].iov_len - skip);
+            skip = 0;
+        }
+        after_queueing(oldLen);
+    }
+}
+
+void TcpConnection::send_in_loop(SharedPayload message)
+{
+    mLoop->assert_in_loop_thread();
+    if (mStatus == kDisConnected)
+    {
+        LOG_WARN << "disconnected, give up writing";
+        return;
+    }
+
+    struct iovec vec;
+    vec.iov_base = const_cast<char*>(message->data());
+    vec.iov_len  = message->size();
+
+    bool faultError = false;
+    std::size_t nwrote = write_directly(&vec, 1, vec.iov_len, faultError);
+    assert(nwrote <= vec.iov_len);
+
+    if (!faultError && nwrote < vec.iov_len)
+    {
+        // queue the unwritten tail by reference
+        std::size_t oldLen = mOutputQueue.readable_bytes();
+        mOutputQueue.append(std::move(message), nwrote);
+        after_queueing(oldLen);
+    }
+}
+
+void TcpConnection::send_in_loop(std::string&& message)
+{
+    mLoop->assert_in_loop_thread();
+    if (mStatus == kDisConnected)
+    {
+        LOG_WARN << "disconnected, give up writing";
+        return;
+    }
+
+    struct iovec vec;
+    vec.iov_base = const_cast<char*>(message.data());
+    vec.iov_len  = message.size();
+
+    bool faultError = false;
+    std::size_t nwrote = write_directly(&vec, 1, vec.iov_len, faultError);
+    assert(nwrote <= vec.iov_len);
+
+    if (!faultError && nwrote < vec.iov_len)
+    {
+        // move the string into the output queue
+        std::size_t oldLen = mOutputQueue.readable_bytes();
+        mOutputQueue.append(std::move(message), nwrote);
+        after_queueing(oldLen);
+    }
+}
+
+void TcpConnection::send_in_loop(Buffer&& message)
+{
+    mLoop->assert_in_loop_thread();
+    if (mStatus == kDisConnected)
+    {
+        LOG_WARN << "disconnected, give up writing";
+        return;
+    }
+
+    struct iovec vec;
+    vec.iov_base = message.read_begin();
+    vec.iov_len  = message.readable_bytes();
+
+    bool faultError = false;
+    std::size_t nwrote = write_directly(&vec, 1, vec.iov_len, faultError);
+    assert(nwrote <= vec.iov_len);
+
+    if (!faultError && nwrote < vec.iov_len)
+    {
+        // move the buffer into the output queue
+        std::size_t oldLen = mOutputQueue.readable_bytes();
+        message.retrieve(nwrote);
+        mOutputQueue.append(std::move(message));
+        after_queueing(oldLen);
+    }
+}
+
+void TcpConnection::send_file_in_loop(int fd, off_t offset, std::size_t len)
+{
+    mLoop->assert_in_loop_thread();
+    if (mStatus == kDisConnected)
+    {
+        LOG_WARN << "disconnected, give up writing";
+        return;
+    }
+
+    std::size_t nwrote = 0;
+    bool faultError = false;
+
+    // if output queue is empty, try sending directly
+    if (mOutputQueue.empty())
+    {
+        off_t off = offset;
+        ssize_t n = ::sendfile(mChannel->get_fd(), fd, &off, len);
+        if (n < 0)
         {
-            nwrote = 0;
             if (errno != EWOULDBLOCK)
             {
-                LOG_SYSERROR << "TcpConnection::send_in_loop";
-                if (errno == ECONNRESET || errno == EPIPE) // FIXME: any other?
+                LOG_SYSERROR << "TcpConnection::send_file_in_loop";
+                if (errno == ECONNRESET || errno == EPIPE)
                 {
                     faultError = true;
                 }
             }
         }
-        else  // nwrote >= 0
+        else
         {
-            remaining = len - static_cast<std::size_t>(nwrote);
-            if (remaining == 0 && mWriteCompleteCallback)
+            nwrote = static_cast<std::size_t>(n);
+            if (nwrote == len && mWriteCompleteCallback)
             {
                 mLoop->queue_in_loop(std::bind(mWriteCompleteCallback,
                     shared_from_this()));
@@ -407,22 +843,84 @@ void TcpConnection::send_in_loop(const void* data, std::size_t len)
         }
     }
 
-    assert(remaining <= len);
-    if (!faultError && remaining > 0)
+    assert(nwrote <= len);
+    if (!faultError && nwrote < len)
+    {
+        std::size_t oldLen = mOutputQueue.readable_bytes();
+        mOutputQueue.append_file(fd, offset + static_cast<off_t>(nwrote), 
+            len - nwrote);
+        after_queueing(oldLen);
+    }
+}
+
+std::size_t TcpConnection::write_directly(const struct iovec* iov, int iovcnt,
+                                          std::size_t len, bool& faultError)
+{
+    // if output queue is empty, try writing directly
+    if (!mOutputQueue.empty())
     {
-        std::size_t oldLen = mOutputBuffer.readable_bytes();
-        if (oldLen + remaining >= mHighWaterMark
-            && oldLen < mHighWaterMark
-            && mHighWaterMarkCallback)
+        return 0;
+    }
+
+    // writev(2) takes at most IOV_MAX pieces, write them in chunks
+    // until the socket takes less than a chunk
+    std::size_t total = 0;
+    while (iovcnt > 0)
+    {
+        int count = std::min(iovcnt, IOV_MAX);
+        ssize_t nwrote = ::writev(mChannel->get_fd(), iov, count);
+        if (nwrote < 0)     // error
         {
-            mLoop->queue_in_loop(std::bind(mHighWaterMarkCallback, 
-                shared_from_this(), oldLen + remaining));
+            if (errno != EWOULDBLOCK)
+            {
+                LOG_SYSERROR << "TcpConnection::send_in_loop";
+                if (errno == ECONNRESET || errno == EPIPE) // FIXME: any other?
+                {
+                    faultError = true;
+                }
+            }
+            break;
         }
-        mOutputBuffer.append(static_cast<const char*>(data) + nwrote, remaining);
-        if (!mChannel->is_writing())
+
+        std::size_t chunkLen = 0;
+        for (int i = 0; i < count; ++i)
         {
-            mChannel->enable_write();
+            chunkLen += iov[i].iov_len;
         }
+
+        total += static_cast<std::size_t>(nwrote);
+        if (static_cast<std::size_t>(nwrote) < chunkLen)
+        {
+            break;
+        }
+
+        iov += count;
+        iovcnt -= count;
+    }
+
+    if (total == len && mWriteCompleteCallback)
+    {
+        mLoop->queue_in_loop(std::bind(mWriteCompleteCallback,
+            shared_from_this()));
+    }
+
+    return total;
+}
+
+void TcpConnection::after_queueing(std::size_t oldLen)
+{
+    std::size_t newLen = mOutputQueue.readable_bytes();
+    if (newLen >= mHighWaterMark
+        && oldLen < mHighWaterMark
+        && mHighWaterMarkCallback)
+    {
+        mLoop->queue_in_loop(std::bind(mHighWaterMarkCallback, 
+            shared_from_this(), newLen));
+    }
+
+    if (!mChannel->is_writing())
+    {
+        mChannel->enable_write();
     }
 }
 
@@ -430,7 +928,7 @@ void TcpConnection::send_in_loop(const void* data, std::size_t len)
 void TcpConnection::shutdown_in_loop()
 {
     mLoop->assert_in_loop_thread();
-    if (!mChannel->is_writing())
+    if (mOutputQueue.empty())
     {
         mSocket->shutdown_write();
     }
@@ -3,16 +3,20 @@
 #define ASUKA_TCP_CONNECTION_HPP
 
 #include <atomic>
+#include <initializer_list>
 #include <memory>
 
 #include <netinet/tcp.h>
+#include <sys/uio.h>
 
 #include "../util/any.hpp"
 #include "../util/noncopyable.hpp"
 #include "../util/string_view.hpp"
 #include "buffer.hpp"
 #include "callback.hpp"
+#include "channel.hpp"
 #include "ip_port.hpp"
+#include "output_queue.hpp"
 
 namespace Asuka
 {
@@ -49,8 +53,31 @@ public:
 
     void send(const void* message, std::size_t len);
     void send(const StringView& message);
+    // a string literal, neither a std::string&& nor a StringView is
+    // a better match for it
+    void send(const char* message);
     void send(Buffer& message);  // will swap data
 
+    // take over the message, it is moved into the output queue
+    // and never copied even if called from another thread
+    void send(std::string&& message);
+    void send(Buffer&& message);
+
+    // gather send, the pieces are written by writev(2), IOV_MAX at a time
+    // if the output queue is empty, only the unwritten tail is copied
+    // called from another thread, the pieces are copied into one message
+    void send(const struct iovec* iov, int iovcnt);
+    void send(std::initializer_list<StringView> messages);
+
+    // the payload is queued by reference and written from the shared storage
+    // a broadcast to many connections costs no extra copy
+    void send(SharedPayload message);
+
+    // send [offset, offset + len) of the file `fd` by sendfile(2)
+    // it is queued in order with other data, and counts toward high water mark
+    // the caller owns `fd`, keep it open until the write complete callback
+    void send_file(int fd, off_t offset, std::size_t len);
+
     // FIXME not thread safe, no simultaneous calling
     void shutdown();
     void force_close();
@@ -58,10 +85,41 @@ public:
 
     void set_tcp_no_delay();    // default is on
 
+    // SO_BUSY_POLL of the socket, see Socket::set_busy_poll
+    void set_busy_poll(int microseconds);
+
+    // the events of a HIGH connection, e.g. a control connection, are 
+    // handled before NORMAL ones in a loop iteration, default NORMAL
+    // call it in the loop thread, e.g. in the connection callback
+    void set_priority(ChannelPriority priority);
+
     void start_read();
     void stop_read();
     bool is_reading() const;
 
+    // statistics of reading, only accessed in the loop thread
+    struct ReadStats
+    {
+        std::uint64_t events;   // readable events handled
+        std::uint64_t reads;    // read(2) calls
+        std::uint64_t bytes;    // bytes read
+    };
+
+    const ReadStats& get_read_stats() const;
+
+    // the target size of a read, it grows when reads fill it,
+    // and shrinks when reads are far less than it
+    // with buffer pooling, the input block is not grown for it,
+    // a large read goes into the loop's slab
+    std::size_t get_read_size() const;
+
+    // keep reading in one readable event until the socket is drained
+    // or `bytes` bytes have been read, 0 means one read per event, default
+    // if edge-triggered, 0 means reading until drained, and the rest after
+    // `bytes` bytes is read later in the same loop iteration
+    // not thread safe, call it in the loop thread
+    void set_read_budget(std::size_t bytes);
+
     void set_context(const Any& context);
     const Any& get_context() const;
     Any& get_context();
@@ -73,7 +131,7 @@ public:
     void set_close_callback(CloseCallback cb);
 
     Buffer& get_input_buffer();
-    Buffer& get_output_buffer();
+    OutputQueue& get_output_queue();
 
     // calls when TcpServer accept a new connection
     // should be called only once
@@ -87,12 +145,25 @@ public:
     using Status = std::uint8_t;
 private:
     void handle_read(TimeStamp receivedTime);
+    void adjust_read_size(std::size_t n);
     void handle_write();
     void handle_close();
     void handle_error();
 
     void send_in_loop(const void* data, std::size_t len);
-    
+    void send_in_loop(const struct iovec* iov, int iovcnt);
+    void send_in_loop(SharedPayload message);
+    void send_in_loop(std::string&& message);
+    void send_in_loop(Buffer&& message);
+    void send_file_in_loop(int fd, off_t offset, std::size_t len);
+
+    // try writing directly if nothing is queued
+    // return the number of bytes written
+    std::size_t write_directly(const struct iovec* iov, int iovcnt, 
+                               std::size_t len, bool& faultError);
+
+    // check high water mark and enable writing after queueing data
+    void after_queueing(std::size_t oldLen);
 
     void shutdown_in_loop();
     void force_close_in_loop();
@@ -128,8 +199,12 @@ private:
     CloseCallback mCloseCallback;
 
     std::size_t mHighWaterMark;
+    std::size_t mReadSize;
+    std::size_t mReadBudget;
+    int mShortReads;            // the number of successive short reads
+    ReadStats mReadStats;
     Buffer mInputBuffer;
-    Buffer mOutputBuffer;       // FIXME use list<Buffer>
+    OutputQueue mOutputQueue;
     Any mContext;
 };
 
@@ -22,7 +22,8 @@ public:
     Timer(TimerCallback cb, TimeStamp when, double interval)
         : mCallback(std::move(cb)),
           mExpiration(when),
-          mInterval(interval),
+          mPostponed(),
+          mInterval(Duration::from_seconds(interval)),
           mRepeat(interval > 0.0),
           mSequence(++sNumCreated)
     {
@@ -43,6 +44,32 @@ public:
         return mExpiration;
     }
 
+    // move the expiration, the owner must move the timer in its list
+    void set_expiration(TimeStamp when)
+    {
+        mExpiration = when;
+        mPostponed = TimeStamp::create_invalid_timestamp();
+    }
+
+    // move the expiration to `when` later than it when the timer expires,
+    // so the owner does not move the timer in its list now
+    void postpone(TimeStamp when)
+    {
+        mPostponed = when;
+    }
+
+    // whether the timer expired at `now` is postponed to after `now`
+    bool is_postponed(TimeStamp now) const
+    {
+        return mPostponed.is_valid() && now < mPostponed;
+    }
+
+    // the expiration after the postponing
+    TimeStamp get_deadline() const
+    {
+        return mPostponed.is_valid() ? mPostponed : mExpiration;
+    }
+
     std::uint64_t get_sequence() const
     {
         return mSequence;
@@ -55,9 +82,13 @@ public:
 
     void restart(TimeStamp now)
     {
-        if (mRepeat)
+        if (is_postponed(now))
+        {
+            set_expiration(mPostponed);
+        }
+        else if (mRepeat)
         {
-            mExpiration = now + mInterval;
+            set_expiration(now + mInterval);
         }
         else
         {
@@ -67,6 +98,7 @@ public:
 private:
     const TimerCallback mCallback;
     TimeStamp mExpiration;
+    TimeStamp mPostponed;       // invalid if not postponed
     const Duration mInterval;
     const bool mRepeat;
     const std::uint64_t mSequence;
@@ -4,7 +4,6 @@
 #include <unistd.h>
 
 #include <cassert>
-#include <climits>
 #include <cstring>
 
 #include "../util/logger.hpp"
@@ -39,12 +38,9 @@ int create_timerfd()
 
 struct timespec get_time_from_now(TimeStamp later)
 {
-    std::uint64_t us = later.get_microseconds()
+    // signed, `later` may have passed already
+    std::int64_t us = later.get_microseconds()
         - TimeStamp::now().get_microseconds();
-
-    // to avoid overflowing
-    assert(us < INT_MAX);
-
     if (us < 100)
     {
         us = 100;
@@ -96,8 +92,15 @@ TimerQueue::TimerQueue(EventLoop* loop)
       mTimers(),
       mActiveTimers(),
       mCancelTimers(),
-      mIsCallingExpiredTimers(false)
+      mIsCallingExpiredTimers(false),
+      mFiredCount(0),
+      mSlack(),
+      mProgrammedExpiration(),
+      mTimerfdSetCount(0)
 {
+    mTimerChannel.set_name("timer");
+    mTimerChannel.set_priority(ChannelPriority::HIGH);
+
     // always read the timerfd
     mTimerChannel.set_read_callback(
         std::bind(&TimerQueue::handle_read, this));
@@ -122,26 +125,44 @@ TimerId TimerQueue::add_timer(TimerCallback cb, TimeStamp when, double interval)
 #endif // CXX14
     TimerId timerid{ timer.get(), timer->get_sequence() };
 
-    mLoop->run_in_loop(std::bind([this, &timer]
-        () { this->add_timer_in_loop(std::move(timer)); }));
+    // the timer is owned by the task until it runs in the loop
+    mLoop->run_in_loop(std::bind([this](std::unique_ptr<Timer>& t)
+        { this->add_timer_in_loop(std::move(t)); }, std::move(timer)));
 
     return timerid;
 }
 
 void TimerQueue::cancel(const TimerId& timerid)
 {
-    mLoop->run_in_loop([this, &timerid]
+    mLoop->run_in_loop([this, timerid]
         () { this->cancel_in_loop(timerid); });
 }
 
+std::uint64_t TimerQueue::fired_count() const
+{
+    return mFiredCount.load(std::memory_order_relaxed);
+}
+
+void TimerQueue::set_slack(Duration slack)
+{
+    mLoop->assert_in_loop_thread();
+    mSlack = slack;
+}
+
+std::uint64_t TimerQueue::timerfd_set_count() const
+{
+    return mTimerfdSetCount.load(std::memory_order_relaxed);
+}
+
 void TimerQueue::add_timer_in_loop(std::unique_ptr<Timer> timer)
 {
     mLoop->assert_in_loop_thread();
     
+    TimeStamp when = timer->get_expiration();
     bool earliestChanged = insert(std::move(timer));
     if (earliestChanged)
     {
-        reset_timerfd(mTimerFd, timer->get_expiration());
+        program_timerfd(when);
     }
 }
 
@@ -167,23 +188,77 @@ void TimerQueue::cancel_in_loop(const TimerId& timerid)
     assert(mTimers.size() == mActiveTimers.size());
 }
 
+bool TimerQueue::reschedule_in_loop(const TimerId& timerid, TimeStamp when,
+                                    bool isExtending)
+{
+    mLoop->assert_in_loop_thread();
+    assert(mTimers.size() == mActiveTimers.size());
+
+    auto iter = mActiveTimers.find(timerid);
+    if (iter == mActiveTimers.end() 
+        || iter->get_sequence() != timerid.get_sequence())
+    {
+        return false;
+    }
+
+    Timer* timer = iter->get_timer();
+    if (isExtending && !(timer->get_deadline() < when))
+    {
+        return true;
+    }
+
+    if (!(when < timer->get_expiration()))
+    {
+        // lazily, the timer list is not touched
+        timer->postpone(when);
+        return true;
+    }
+
+    // earlier, move it in `mTimers`
+    auto timerIter = mTimers.find({ timer->get_expiration(), 
+        timer->get_sequence() });
+    assert(timerIter != mTimers.end());
+    std::unique_ptr<Timer> owned = std::move(timerIter->second);
+    mTimers.erase(timerIter);
+    mActiveTimers.erase(iter);
+
+    owned->set_expiration(when);
+    if (insert(std::move(owned)))
+    {
+        program_timerfd(when);
+    }
+    return true;
+}
+
 void TimerQueue::handle_read()
 {
     mLoop->assert_in_loop_thread();
     TimeStamp now = TimeStamp::now();
 
     read_timerfd(mTimerFd, now);
+    // it is disarmed after expiring
+    mProgrammedExpiration = TimeStamp::create_invalid_timestamp();
 
     std::vector<Entry> expireds = get_expired(now);
 
     mIsCallingExpiredTimers = true;
     mCancelTimers.clear();
+    std::uint64_t fired = 0;
     for (auto& e : expireds)
     {
-        e.second->run();
+        // a postponed one is inserted again in reset()
+        if (!e.second->is_postponed(now))
+        {
+            e.second->run();
+            ++fired;
+        }
     }
     mIsCallingExpiredTimers = false;
 
+    // only written in the loop thread
+    mFiredCount.store(mFiredCount.load(std::memory_order_relaxed) + fired,
+                      std::memory_order_relaxed);
+
     reset(expireds, now);
 }
 
@@ -224,7 +299,7 @@ void TimerQueue::reset(std::vector<Entry>& expired, TimeStamp now)
     for (auto& e : expired)
     {
         TimerId timerid{ e.second.get(), e.second->get_sequence() };
-        if (e.second->is_repeat()
+        if ((e.second->is_repeat() || e.second->is_postponed(now))
             && mCancelTimers.find(timerid) == mCancelTimers.end())
         {
             e.second->restart(now);
@@ -240,10 +315,31 @@ void TimerQueue::reset(std::vector<Entry>& expired, TimeStamp now)
 
     if (nextExpired.is_valid())
     {
-        reset_timerfd(mTimerFd, nextExpired);
+        program_timerfd(nextExpired);
     }
 }
 
+void TimerQueue::program_timerfd(TimeStamp when)
+{
+    std::int64_t slack = mSlack.to_microseconds();
+    if (slack > 0)
+    {
+        std::int64_t us = when.get_microseconds();
+        when = TimeStamp{ (us + slack - 1) / slack * slack };
+    }
+
+    // the earlier expiration handles this one too
+    if (mProgrammedExpiration.is_valid() && !(when < mProgrammedExpiration))
+    {
+        return;
+    }
+
+    reset_timerfd(mTimerFd, when);
+    mProgrammedExpiration = when;
+    mTimerfdSetCount.store(mTimerfdSetCount.load(std::memory_order_relaxed)
+        + 1, std::memory_order_relaxed);
+}
+
 bool TimerQueue::insert(std::unique_ptr<Timer> timer)
 {
     mLoop->assert_in_loop_thread();
@@ -2,11 +2,13 @@
 #ifndef ASUKA_TIMER_QUEUE_HPP
 #define ASUKA_TIMER_QUEUE_HPP
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <set>
 #include <vector>
 
+#include "../util/duration.hpp"
 #include "../util/noncopyable.hpp"
 #include "../util/time_stamp.hpp"
 #include "callback.hpp"
@@ -42,6 +44,21 @@ public:
     TimerId add_timer(TimerCallback cb, TimeStamp when, double interval);
     void cancel(const TimerId& timerid);
 
+    // move the expiration of a timer to `when`, if `isExtending`, only 
+    // to a later one, a later one is applied when the timer expires
+    // false if `timerid` is not a timer waiting in the queue
+    bool reschedule_in_loop(const TimerId& timerid, TimeStamp when, 
+                            bool isExtending);
+
+    // the number of timer callbacks run, thread safe
+    std::uint64_t fired_count() const;
+
+    // see EventLoop::set_timer_slack
+    void set_slack(Duration slack);
+
+    // the number of timerfd_settime calls, thread safe
+    std::uint64_t timerfd_set_count() const;
+
 private:
     void add_timer_in_loop(std::unique_ptr<Timer> timer);
     void cancel_in_loop(const TimerId& timerid);
@@ -55,6 +72,10 @@ private:
     void reset(std::vector<Entry>& expired, TimeStamp now);
     bool insert(std::unique_ptr<Timer> timer);
 
+    // arm the timerfd for `when` rounded up to the slack,
+    // unless it is armed for an earlier time already
+    void program_timerfd(TimeStamp when);
+
 private:
     EventLoop* mLoop;
     const int mTimerFd;
@@ -67,6 +88,13 @@ private:
     TimerIdSet mActiveTimers;
     TimerIdSet mCancelTimers;
     bool mIsCallingExpiredTimers;  // is calling handle_read()
+
+    std::atomic<std::uint64_t> mFiredCount;
+
+    Duration mSlack;
+    // the time the timerfd is armed for, invalid if disarmed
+    TimeStamp mProgrammedExpiration;
+    std::atomic<std::uint64_t> mTimerfdSetCount;
 };
 
 } // namespace Net
@@ -0,0 +1,328 @@
+﻿#include "timing_wheel.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <functional>
+
+#include "event_loop.hpp"
+
+namespace Asuka
+{
+
+namespace Net
+{
+
+struct TimingWheel::Node : TimingWheel::Link
+{
+    Node(TimerCallback cb, TimeStamp when, double interval)
+        : Link{ nullptr, nullptr },
+          timer(std::move(cb), when, interval),
+          tick(0),
+          isCanceled(false)
+    {
+    }
+
+    Timer timer;
+    std::uint64_t tick;     // the tick to fire
+    bool isCanceled;        // canceled by its own callback
+};
+
+TimingWheel::TimingWheel(EventLoop* loop, double tickSeconds)
+    : mLoop(loop),
+      mTickMicroseconds(std::max(std::int64_t{ Duration::kMillisecond },
+          Duration::from_seconds(tickSeconds).to_microseconds())),
+      mCurrentTick(0),
+      mNodes(),
+      mRunningNode(nullptr)
+{
+    for (auto& level : mSlots)
+    {
+        for (Slot& slot : level)
+        {
+            slot.prev = &slot;
+            slot.next = &slot;
+        }
+    }
+
+    mCurrentTick = static_cast<std::uint64_t>(
+        TimeStamp::now().get_microseconds() / mTickMicroseconds);
+}
+
+TimingWheel::~TimingWheel()
+{
+    for (auto& entry : mNodes)
+    {
+        delete entry.second;
+    }
+}
+
+TimerId TimingWheel::add_timer(TimerCallback cb, TimeStamp when, 
+                               double interval)
+{
+    std::unique_ptr<Node> node{ new Node{ std::move(cb), when, interval } };
+    TimerId timerid{ &node->timer, node->timer.get_sequence() };
+
+    // the node is owned by the task until it runs in the loop
+    mLoop->run_in_loop(std::bind([this](std::unique_ptr<Node>& n)
+        { this->add_timer_in_loop(std::move(n)); }, std::move(node)));
+
+    return timerid;
+}
+
+bool TimingWheel::cancel_in_loop(const TimerId& timerid)
+{
+    mLoop->assert_in_loop_thread();
+
+    Node* node = find(timerid);
+    if (node == nullptr)
+    {
+        return false;
+    }
+
+    if (node == mRunningNode)
+    {
+        // deleted after its callback returns
+        node->isCanceled = true;
+        return true;
+    }
+
+    unlink(node);
+    mNodes.erase(node->timer.get_sequence());
+    delete node;
+    return true;
+}
+
+bool TimingWheel::reschedule_in_loop(const TimerId& timerid, TimeStamp when,
+                                     bool isExtending)
+{
+    mLoop->assert_in_loop_thread();
+
+    Node* node = find(timerid);
+    if (node == nullptr || node == mRunningNode)
+    {
+        return false;
+    }
+
+    if (isExtending && !(node->timer.get_expiration() < when))
+    {
+        return true;
+    }
+
+    node->timer.set_expiration(when);
+    node->tick = to_tick(when);
+    unlink(node);
+    insert(node);
+    return true;
+}
+
+std::size_t TimingWheel::expire(TimeStamp now)
+{
+    mLoop->assert_in_loop_thread();
+    if (now.get_microseconds() < 0)
+    {
+        return 0;
+    }
+
+    std::uint64_t nowTick = static_cast<std::uint64_t>(
+        now.get_microseconds() / mTickMicroseconds);
+    if (mNodes.empty())
+    {
+        // nothing to run, skip the idle ticks
+        if (nowTick >= mCurrentTick)
+        {
+            mCurrentTick = nowTick + 1;
+        }
+        return 0;
+    }
+
+    std::size_t fired = 0;
+    while (mCurrentTick <= nowTick)
+    {
+        std::uint64_t index = mCurrentTick & kSlotMask;
+        if (index == 0)
+        {
+            // level n reaches its next slot when level n - 1 wraps
+            for (int level = 1; level < kLevels; ++level)
+            {
+                cascade(level);
+                if (((mCurrentTick >> (kLevelBits * level)) & kSlotMask) != 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        // the timers added by the callbacks go to the later ticks
+        ++mCurrentTick;
+        fired += run(mSlots[0][index], now);
+    }
+
+    return fired;
+}
+
+int TimingWheel::get_timeout(TimeStamp now) const
+{
+    if (mNodes.empty())
+    {
+        return -1;
+    }
+
+    // the next tick with timers of level 0, or the next cascade
+    std::uint64_t tick = mCurrentTick;
+    while ((tick & kSlotMask) != 0 && is_empty(mSlots[0][tick & kSlotMask]))
+    {
+        ++tick;
+    }
+
+    std::int64_t us = static_cast<std::int64_t>(tick) * mTickMicroseconds
+        - now.get_microseconds();
+    if (us <= 0)
+    {
+        return 0;
+    }
+
+    std::int64_t ms = (us + Duration::kMillisecond - 1) / Duration::kMillisecond;
+    return ms < INT_MAX ? static_cast<int>(ms) : INT_MAX;
+}
+
+std::size_t TimingWheel::size() const
+{
+    return mNodes.size();
+}
+
+TimingWheel::Node* TimingWheel::find(const TimerId& timerid) const
+{
+    auto iter = mNodes.find(timerid.get_sequence());
+    if (iter == mNodes.end() || &iter->second->timer != timerid.get_timer())
+    {
+        return nullptr;
+    }
+
+    return iter->second;
+}
+
+void TimingWheel::add_timer_in_loop(std::unique_ptr<Node> node)
+{
+    mLoop->assert_in_loop_thread();
+
+    node->tick = to_tick(node->timer.get_expiration());
+    auto p = mNodes.emplace(node->timer.get_sequence(), node.get());
+    assert(p.second);
+    (void)p;
+
+    insert(node.release());
+}
+
+std::uint64_t TimingWheel::to_tick(TimeStamp when) const
+{
+    std::int64_t us = when.get_microseconds();
+    if (us <= 0)
+    {
+        return 0;
+    }
+
+    // round up, a timer never fires before its expiration
+    return static_cast<std::uint64_t>(
+        (us + mTickMicroseconds - 1) / mTickMicroseconds);
+}
+
+void TimingWheel::insert(Node* node)
+{
+    std::uint64_t tick = std::max(node->tick, mCurrentTick);
+    std::uint64_t distance = tick - mCurrentTick;
+
+    int level = 0;
+    while (level < kLevels - 1 
+        && distance >= (std::uint64_t{ 1 } << (kLevelBits * (level + 1))))
+    {
+        ++level;
+    }
+
+    const std::uint64_t kMaxDistance = 
+        (std::uint64_t{ 1 } << (kLevelBits * kLevels)) - 1;
+    if (distance > kMaxDistance)
+    {
+        // the farthest slot, it is placed again when cascaded
+        tick = mCurrentTick + kMaxDistance;
+    }
+
+    Slot& slot = mSlots[level][(tick >> (kLevelBits * level)) & kSlotMask];
+    node->prev = slot.prev;
+    node->next = &slot;
+    slot.prev->next = node;
+    slot.prev = node;
+}
+
+void TimingWheel::unlink(Link* link)
+{
+    link->prev->next = link->next;
+    link->next->prev = link->prev;
+    link->prev = nullptr;
+    link->next = nullptr;
+}
+
+bool TimingWheel::is_empty(const Slot& slot)
+{
+    return slot.next == &slot;
+}
+
+void TimingWheel::cascade(int level)
+{
+    Slot& slot = mSlots[level][(mCurrentTick >> (kLevelBits * level)) 
+        & kSlotMask];
+    while (!is_empty(slot))
+    {
+        Node* node = static_cast<Node*>(slot.next);
+        unlink(node);
+        insert(node);
+    }
+}
+
+std::size_t TimingWheel::run(Slot& slot, TimeStamp now)
+{
+    if (is_empty(slot))
+    {
+        return 0;
+    }
+
+    // detach the nodes, a callback may add timers to the same slot
+    Slot expired;
+    expired.prev = slot.prev;
+    expired.next = slot.next;
+    expired.prev->next = &expired;
+    expired.next->prev = &expired;
+    slot.prev = &slot;
+    slot.next = &slot;
+
+    std::size_t fired = 0;
+    while (!is_empty(expired))
+    {
+        // a callback may cancel the other expired nodes
+        Node* node = static_cast<Node*>(expired.next);
+        unlink(node);
+
+        mRunningNode = node;
+        node->timer.run();
+        mRunningNode = nullptr;
+        ++fired;
+
+        if (node->timer.is_repeat() && !node->isCanceled)
+        {
+            node->timer.restart(now);
+            node->tick = to_tick(node->timer.get_expiration());
+            insert(node);
+        }
+        else
+        {
+            mNodes.erase(node->timer.get_sequence());
+            delete node;
+        }
+    }
+
+    return fired;
+}
+
+} // namespace Net
+
+} // namespace Asuka
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+#ifndef ASUKA_TIMING_WHEEL_HPP
+#define ASUKA_TIMING_WHEEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+#include "../util/noncopyable.hpp"
+#include "../util/time_stamp.hpp"
+#include "callback.hpp"
+#include "timer.hpp"
+#include "timer_id.hpp"
+
+namespace Asuka
+{
+
+namespace Net
+{
+
+class EventLoop;
+
+// hierarchical timing wheel for coarse timers, e.g. idle timeouts
+// time is divided into ticks, a timer fires in the first tick after
+// its expiration, so it is late by one tick at most
+// adding and canceling are O(1), the loop polls until the next tick
+// that has timers instead of using a timerfd
+//
+// the wheel has kLevels levels of kSlots slots, a slot of level 0 is
+// a tick, a slot of level n is kSlots ticks of level n - 1, a timer is
+// cascaded to a lower level when the wheel reaches its slot
+class TimingWheel : Noncopyable
+{
+public:
+    TimingWheel(EventLoop* loop, double tickSeconds);
+    ~TimingWheel();
+
+    // thread safe
+    TimerId add_timer(TimerCallback cb, TimeStamp when, double interval);
+
+    // false if `timerid` is not a timer of the wheel
+    bool cancel_in_loop(const TimerId& timerid);
+
+    // move the expiration of a timer to `when`, if `isExtending`, only
+    // to a later one, O(1) and no allocation
+    // false if `timerid` is not a timer waiting in the wheel
+    bool reschedule_in_loop(const TimerId& timerid, TimeStamp when,
+                            bool isExtending);
+
+    // run the timers expired at `now`,
+    // return the number of timer callbacks run
+    std::size_t expire(TimeStamp now);
+
+    // milliseconds until the next tick with work, -1 if no timer
+    int get_timeout(TimeStamp now) const;
+
+    // the number of timers added and not fired or canceled
+    std::size_t size() const;
+
+private:
+    static const int kLevelBits = 8;
+    static const std::uint64_t kSlots = 1 << kLevelBits;
+    static const std::uint64_t kSlotMask = kSlots - 1;
+    static const int kLevels = 4;
+
+    struct Link
+    {
+        Link* prev;
+        Link* next;
+    };
+
+    // a slot is a circular list of nodes with a dummy head
+    using Slot = Link;
+
+    struct Node;
+
+private:
+    void add_timer_in_loop(std::unique_ptr<Node> node);
+    Node* find(const TimerId& timerid) const;
+
+    std::uint64_t to_tick(TimeStamp when) const;
+    void insert(Node* node);
+    static void unlink(Link* link);
+    static bool is_empty(const Slot& slot);
+    void cascade(int level);
+    std::size_t run(Slot& slot, TimeStamp now);
+
+private:
+    EventLoop* mLoop;
+    const std::int64_t mTickMicroseconds;
+
+    // the next tick to run, the ticks before it have run
+    std::uint64_t mCurrentTick;
+    Slot mSlots[kLevels][kSlots];
+
+    // <sequence, Node*> for canceling
+    std::unordered_map<std::uint64_t, Node*> mNodes;
+    Node* mRunningNode;
+};
+
+} // namespace Net
+
+} // namespace Asuka
+
+#endif // ASUKA_TIMING_WHEEL_HPP
\ No newline at end of file
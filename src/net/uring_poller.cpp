@@ -0,0 +1,594 @@
+﻿#include "uring_poller.hpp"
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define ASUKA_HAVE_IO_URING
+#endif
+#endif
+
+#if defined(ASUKA_HAVE_IO_URING) && !defined(IORING_SQ_CQ_OVERFLOW)
+#define IORING_SQ_CQ_OVERFLOW (1U << 1)
+#endif
+
+#include "../util/logger.hpp"
+#include "../util/time_stamp.hpp"
+#include "channel.hpp"
+
+namespace Asuka
+{
+
+namespace Net
+{
+
+#ifdef ASUKA_HAVE_IO_URING
+
+namespace
+{
+
+int io_uring_setup(unsigned entries, struct io_uring_params* params)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete,
+                   unsigned flags, void* arg, std::size_t argSize)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit,
+        minComplete, flags, arg, argSize));
+}
+
+unsigned load_acquire(const unsigned* p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+void store_release(unsigned* p, unsigned value)
+{
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+void* map_ring(int fd, std::size_t size, off_t offset)
+{
+    void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, offset);
+    return p == MAP_FAILED ? nullptr : p;
+}
+
+// a poll request and its removal complete at most once each,
+// so twice the fd limit is enough to never overflow
+unsigned get_cq_entries(unsigned minEntries, unsigned maxEntries)
+{
+    struct rlimit limit;
+    if (::getrlimit(RLIMIT_NOFILE, &limit) != 0 
+        || limit.rlim_cur == RLIM_INFINITY
+        || limit.rlim_cur >= maxEntries / 2)
+    {
+        return maxEntries;
+    }
+
+    return std::max(minEntries, static_cast<unsigned>(limit.rlim_cur * 2));
+}
+
+// user_data of a poll request, <fd, sequence>
+// user_data of a removing request is 0, its completion is ignored
+std::uint64_t make_user_data(int fd, std::uint32_t seq)
+{
+    return (static_cast<std::uint64_t>(fd) << 32) | seq;
+}
+
+} // unamed namespace
+
+#endif // ASUKA_HAVE_IO_URING
+
+
+UringPoller::UringPoller(EventLoop* loop)
+    : PollerBase(loop),
+      mRingFd(-1),
+      mSqEntries(0),
+      mSqRing(nullptr),
+      mSqRingSize(0),
+      mCqRing(nullptr),
+      mCqRingSize(0),
+      mSqes(nullptr),
+      mSqesSize(0),
+      mSqHead(nullptr),
+      mSqTail(nullptr),
+      mSqMask(nullptr),
+      mSqArray(nullptr),
+      mSqFlags(nullptr),
+      mCqHead(nullptr),
+      mCqTail(nullptr),
+      mCqMask(nullptr),
+      mCqes(nullptr),
+      mSqLocalTail(0),
+      mSequence(0),
+      mStates(),
+      mDirtyFds(),
+      mCompletions()
+{
+    if (!setup_ring())
+    {
+        close_ring();
+    }
+}
+
+UringPoller::~UringPoller()
+{
+    close_ring();
+}
+
+bool UringPoller::is_open() const
+{
+    return mRingFd >= 0;
+}
+
+const char* UringPoller::get_name() const
+{
+    return "io_uring";
+}
+
+#ifdef ASUKA_HAVE_IO_URING
+
+bool UringPoller::setup_ring()
+{
+    struct io_uring_params params;
+    ::bzero(&params, sizeof(params));
+    // clamp to the max entries of the kernel instead of failing
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+    params.cq_entries = get_cq_entries(kMinCqEntries, kMaxCqEntries);
+
+    mRingFd = io_uring_setup(kSqEntries, &params);
+    if (mRingFd < 0)
+    {
+        LOG_SYSERROR << "io_uring_setup error";
+        return false;
+    }
+
+    // waiting with a timeout needs IORING_ENTER_EXT_ARG, linux 5.11
+    if (!(params.features & IORING_FEAT_EXT_ARG))
+    {
+        LOG_ERROR << "io_uring doesn't support IORING_FEAT_EXT_ARG";
+        return false;
+    }
+
+    mSqEntries = params.sq_entries;
+    mSqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    mCqRingSize = params.cq_off.cqes
+        + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        mSqRingSize = std::max(mSqRingSize, mCqRingSize);
+        mCqRingSize = 0;
+    }
+
+    mSqRing = map_ring(mRingFd, mSqRingSize, IORING_OFF_SQ_RING);
+    if (mSqRing == nullptr)
+    {
+        LOG_SYSERROR << "mmap io_uring submission queue error";
+        return false;
+    }
+
+    if (mCqRingSize == 0)
+    {
+        mCqRing = mSqRing;
+    }
+    else
+    {
+        mCqRing = map_ring(mRingFd, mCqRingSize, IORING_OFF_CQ_RING);
+        if (mCqRing == nullptr)
+        {
+            LOG_SYSERROR << "mmap io_uring completion queue error";
+            return false;
+        }
+    }
+
+    mSqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    mSqes = map_ring(mRingFd, mSqesSize, IORING_OFF_SQES);
+    if (mSqes == nullptr)
+    {
+        LOG_SYSERROR << "mmap io_uring submission entries error";
+        return false;
+    }
+
+    char* sq = static_cast<char*>(mSqRing);
+    mSqHead  = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    mSqTail  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    mSqMask  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    mSqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    mSqFlags = reinterpret_cast<unsigned*>(sq + params.sq_off.flags);
+
+    char* cq = static_cast<char*>(mCqRing);
+    mCqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    mCqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    mCqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    mCqes   = cq + params.cq_off.cqes;
+
+    mSqLocalTail = *mSqTail;
+    return true;
+}
+
+void UringPoller::close_ring()
+{
+    if (mSqes != nullptr)
+    {
+        ::munmap(mSqes, mSqesSize);
+        mSqes = nullptr;
+    }
+    if (mCqRing != nullptr && mCqRing != mSqRing)
+    {
+        ::munmap(mCqRing, mCqRingSize);
+    }
+    mCqRing = nullptr;
+    if (mSqRing != nullptr)
+    {
+        ::munmap(mSqRing, mSqRingSize);
+        mSqRing = nullptr;
+    }
+    if (mRingFd >= 0)
+    {
+        close_fd(mRingFd, "close io_uring fd error");
+        mRingFd = -1;
+    }
+}
+
+TimeStamp UringPoller::poll(int timeoutMs, ChannelList& activeChannels)
+{
+    LOG_TRACE << "total fd count = " << channel_count();
+    flush_dirty();
+    enter(timeoutMs);
+    TimeStamp now = TimeStamp::now();
+    fill_active_channels(activeChannels);
+
+    return now;
+}
+
+void UringPoller::update_channel(Channel& channel)
+{
+    PollerBase::assert_in_loop_thread();
+    const int idx = channel.get_index();
+    const int fd = channel.get_fd();
+
+    LOG_TRACE << "fd = " << fd
+        << ", events = " << channel.get_events()
+        << ", index = " << idx;
+
+    if (idx == kNew || idx == kDeleted)
+    {
+        if (idx == kNew)
+        {
+            add_channel(channel);
+        }
+        else // idx == kDeleted
+        {
+            assert(find_channel(fd) == &channel);
+        }
+
+        channel.set_index(kAdded);
+    }
+    else // idx == kAdded
+    {
+        assert(find_channel(fd) == &channel);
+
+        if (channel.is_none_event())
+        {
+            channel.set_index(kDeleted);
+        }
+    }
+
+    // the request is armed when polling
+    mark_dirty(fd);
+}
+
+void UringPoller::remove_channel(Channel& channel)
+{
+    PollerBase::assert_in_loop_thread();
+    int fd = channel.get_fd();
+
+    LOG_TRACE << "remove fd = " << fd;
+    assert(find_channel(fd) == &channel);
+    assert(channel.is_none_event());
+
+    int idx = channel.get_index();
+    assert(idx == kAdded || idx == kDeleted);
+    (void)idx;
+    erase_channel(channel);
+
+    // remove the request now, the fd may be closed and reused
+    PollState& state = get_state(fd);
+    if (state.sequence != 0)
+    {
+        disarm(state, fd);
+    }
+
+    channel.set_index(kNew);
+}
+
+UringPoller::PollState& UringPoller::get_state(int fd)
+{
+    assert(fd >= 0);
+    std::size_t index = static_cast<std::size_t>(fd);
+    if (index >= mStates.size())
+    {
+        mStates.resize(index + 1, PollState{ 0, 0, false });
+    }
+
+    return mStates[index];
+}
+
+void UringPoller::mark_dirty(int fd)
+{
+    PollState& state = get_state(fd);
+    if (!state.isDirty)
+    {
+        state.isDirty = true;
+        mDirtyFds.push_back(fd);
+    }
+}
+
+void UringPoller::flush_dirty()
+{
+    for (int fd : mDirtyFds)
+    {
+        PollState& state = get_state(fd);
+        state.isDirty = false;
+
+        std::uint32_t events = 0;
+        Channel* channel = find_channel(fd);
+        if (channel != nullptr)
+        {
+            events = channel->get_events();
+        }
+
+        if (state.sequence != 0 && state.events == events)
+        {
+            continue;   // armed already
+        }
+
+        if (state.sequence != 0)
+        {
+            disarm(state, fd);
+        }
+        if (events != 0)
+        {
+            arm(fd, state, events);
+        }
+    }
+
+    mDirtyFds.clear();
+}
+
+void UringPoller::arm(int fd, PollState& state, std::uint32_t events)
+{
+    // 0 means no request
+    if (++mSequence == 0)
+    {
+        ++mSequence;
+    }
+
+    struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(get_sqe());
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    // the kernel reads the two 16-bit halves swapped, swap the halfwords
+    // like __swahw32 in liburing, not the bytes
+    sqe->poll32_events = (events << 16) | (events >> 16);
+#else
+    sqe->poll32_events = events;
+#endif
+    sqe->user_data = make_user_data(fd, mSequence);
+
+    state.sequence = mSequence;
+    state.events = events;
+}
+
+void UringPoller::disarm(PollState& state, int fd)
+{
+    struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(get_sqe());
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = make_user_data(fd, state.sequence);
+    sqe->user_data = 0;
+
+    state.sequence = 0;
+    state.events = 0;
+}
+
+void* UringPoller::get_sqe()
+{
+    // full, submit them without waiting, the kernel refuses to submit
+    // while the completions overflow (EBUSY) or it lacks memory (EAGAIN),
+    // so reap the completion queue to make room and try again
+    int attempts = 0;
+    while (mSqLocalTail - load_acquire(mSqHead) == mSqEntries)
+    {
+        if (attempts++ == kMaxSubmitAttempts)
+        {
+            LOG_FATAL << "io_uring submission queue is full, "
+                << "the kernel doesn't take the entries";
+        }
+
+        reap_completions();
+        enter(0);
+    }
+
+    unsigned index = mSqLocalTail & *mSqMask;
+    struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(mSqes) + index;
+    ::bzero(sqe, sizeof(*sqe));
+    mSqArray[index] = index;
+    ++mSqLocalTail;
+    store_release(mSqTail, mSqLocalTail);
+
+    return sqe;
+}
+
+bool UringPoller::is_cq_overflow() const
+{
+    return (load_acquire(mSqFlags) & IORING_SQ_CQ_OVERFLOW) != 0;
+}
+
+void UringPoller::enter(int timeoutMs)
+{
+    unsigned toSubmit = mSqLocalTail - load_acquire(mSqHead);
+    const bool isOverflow = is_cq_overflow();
+    if (toSubmit == 0 && timeoutMs == 0 && !isOverflow)
+    {
+        return;     // only reap the completion queue, no syscall
+    }
+
+    unsigned flags = 0;
+    unsigned minComplete = 0;
+    void* arg = nullptr;
+    std::size_t argSize = 0;
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg getArg;
+    if (timeoutMs != 0 || isOverflow)
+    {
+        // also flushes the overflowed completions
+        flags |= IORING_ENTER_GETEVENTS;
+    }
+    if (timeoutMs != 0)
+    {
+        minComplete = 1;
+    }
+    if (timeoutMs > 0)
+    {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+        ::bzero(&getArg, sizeof(getArg));
+        getArg.sigmask_sz = _NSIG / 8;
+        getArg.ts = reinterpret_cast<std::uint64_t>(&ts);
+
+        flags |= IORING_ENTER_EXT_ARG;
+        arg = &getArg;
+        argSize = sizeof(getArg);
+    }
+
+    // EAGAIN and EBUSY leave the entries queued, they are submitted again
+    int ret = io_uring_enter(mRingFd, toSubmit, minComplete, flags,
+        arg, argSize);
+    if (ret < 0 && errno != ETIME && errno != EINTR
+        && errno != EAGAIN && errno != EBUSY)
+    {
+        LOG_SYSERROR << "io_uring_enter error";
+    }
+}
+
+void UringPoller::reap_completions()
+{
+    unsigned head = *mCqHead;
+    unsigned tail = load_acquire(mCqTail);
+    unsigned mask = *mCqMask;
+    const struct io_uring_cqe* cqes = 
+        static_cast<const struct io_uring_cqe*>(mCqes);
+
+    for (; head != tail; ++head)
+    {
+        const struct io_uring_cqe& cqe = cqes[head & mask];
+        mCompletions.push_back(Completion{ cqe.user_data, cqe.res });
+    }
+
+    store_release(mCqHead, head);
+}
+
+void UringPoller::fill_active_channels(ChannelList& activeChannels)
+{
+    // the completions reaped to submit come first, they are older
+    reap_completions();
+    while (is_cq_overflow())
+    {
+        enter(0);
+        reap_completions();
+    }
+
+    LOG_TRACE << mCompletions.size() << " completions";
+
+    for (const Completion& completion : mCompletions)
+    {
+        if (completion.userData == 0)
+        {
+            continue;   // removing request
+        }
+
+        int fd = static_cast<int>(completion.userData >> 32);
+        std::uint32_t seq = static_cast<std::uint32_t>(completion.userData);
+        PollState& state = get_state(fd);
+        if (state.sequence != seq)
+        {
+            continue;   // stale, it has been disarmed
+        }
+
+        Channel* channel = find_channel(fd);
+        assert(channel != nullptr);
+
+        // the request is done, arm it again in the next poll
+        state.sequence = 0;
+        state.events = 0;
+        mark_dirty(fd);
+
+        if (completion.res < 0)
+        {
+            if (completion.res == -ECANCELED)
+            {
+                continue;
+            }
+            errno = -completion.res;
+            LOG_SYSERROR << "io_uring poll fd = " << fd << " error";
+            channel->set_revents(POLLERR);
+        }
+        else
+        {
+            channel->set_revents(static_cast<std::uint32_t>(completion.res));
+        }
+        activeChannels.push_back(channel);
+    }
+
+    mCompletions.clear();
+}
+
+#else // ASUKA_HAVE_IO_URING
+
+bool UringPoller::setup_ring()
+{
+    LOG_ERROR << "io_uring is not support";
+    return false;
+}
+
+void UringPoller::close_ring()
+{
+}
+
+TimeStamp UringPoller::poll(int, ChannelList&)
+{
+    LOG_FATAL << "io_uring is not support";
+    return TimeStamp::now();
+}
+
+void UringPoller::update_channel(Channel&)
+{
+    LOG_FATAL << "io_uring is not support";
+}
+
+void UringPoller::remove_channel(Channel&)
+{
+    LOG_FATAL << "io_uring is not support";
+}
+
+#endif // ASUKA_HAVE_IO_URING
+
+} // namespace Net
+
+} // namespace Asuka
\ No newline at end of file
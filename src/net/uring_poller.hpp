@@ -0,0 +1,122 @@
+#pragma once
+#ifndef ASUKA_URING_POLLER_HPP
+#define ASUKA_URING_POLLER_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "poller_base.hpp"
+
+namespace Asuka
+{
+
+namespace Net
+{
+
+// I/O multiplexing with io_uring(7) IORING_OP_POLL_ADD requests
+// a request is armed for the interested events of a channel, and it is
+// armed again after it completes, so it is level-triggered like poll(2)
+// the requests of updated channels are queued, and submitted together
+// when polling, so a poll costs one io_uring_enter(2) at most
+// the completion queue is sized from RLIMIT_NOFILE, the completions
+// which overflow it are held by the kernel and flushed when polling
+class UringPoller : public PollerBase
+{
+public:
+    explicit UringPoller(EventLoop* loop);
+    ~UringPoller() override;
+
+    // false if the kernel doesn't support io_uring or a needed feature
+    // the poller must not be used then
+    bool is_open() const;
+
+    TimeStamp poll(int timeoutMs, ChannelList& activeChannels) override;
+
+    void update_channel(Channel& channel) override;
+
+    void remove_channel(Channel& channel) override;
+
+    const char* get_name() const override;
+
+private:
+    static const unsigned kSqEntries = 256;
+    static const unsigned kMinCqEntries = 4096;
+    static const unsigned kMaxCqEntries = 65536;
+    // io_uring_enter(2) calls to make room in a full submission queue
+    static const int kMaxSubmitAttempts = 16;
+    static const int kNew     = -1;
+    static const int kAdded   = 1;
+    static const int kDeleted = 2;
+
+    // the poll request of a fd
+    struct PollState
+    {
+        std::uint32_t sequence; // of the armed request, 0 if none
+        std::uint32_t events;   // armed events
+        bool isDirty;           // need to be armed again
+    };
+
+    // a completion taken from the completion queue
+    struct Completion
+    {
+        std::uint64_t userData;
+        std::int32_t res;
+    };
+
+private:
+    bool setup_ring();
+    void close_ring();
+
+    PollState& get_state(int fd);
+    void mark_dirty(int fd);
+
+    // arm or disarm the requests of the dirty fds
+    void flush_dirty();
+    void arm(int fd, PollState& state, std::uint32_t events);
+    void disarm(PollState& state, int fd);
+
+    // get a free submission queue entry, submit if the queue is full
+    void* get_sqe();
+    // submit the queued entries, wait for a completion if `timeoutMs` != 0
+    // the overflowed completions are flushed to the completion queue
+    void enter(int timeoutMs);
+    bool is_cq_overflow() const;
+    // move the completions out of the completion queue to mCompletions
+    void reap_completions();
+    void fill_active_channels(ChannelList& activeChannels);
+
+private:
+    int mRingFd;
+    unsigned mSqEntries;
+
+    void* mSqRing;
+    std::size_t mSqRingSize;
+    void* mCqRing;
+    std::size_t mCqRingSize;
+    void* mSqes;
+    std::size_t mSqesSize;
+
+    // shared with the kernel
+    unsigned* mSqHead;
+    unsigned* mSqTail;
+    unsigned* mSqMask;
+    unsigned* mSqArray;
+    unsigned* mSqFlags;
+    unsigned* mCqHead;
+    unsigned* mCqTail;
+    unsigned* mCqMask;
+    void* mCqes;
+
+    unsigned mSqLocalTail;      // entries before it are queued
+
+    std::uint32_t mSequence;
+    std::vector<PollState> mStates;     // indexed by fd
+    std::vector<int> mDirtyFds;
+    std::vector<Completion> mCompletions;
+};
+
+} // namespace Net
+
+} // namespace Asuka
+
+#endif // ASUKA_URING_POLLER_HPP
\ No newline at end of file
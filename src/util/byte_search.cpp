@@ -0,0 +1,231 @@
+﻿#include "byte_search.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__)
+#  include <immintrin.h>
+#  define ASUKA_X86_64 1
+#endif // __x86_64__
+
+namespace Asuka
+{
+
+namespace 
+{
+
+using FindCrlf = const char* (*)(const char*, const char*);
+using FindAnyOf = const char* (*)(const char*, const char*, 
+                                  const char*, std::size_t);
+
+// the max set size compared by SIMD, a larger set uses a lookup table
+const std::size_t kMaxSimdSetSize = 16;
+
+const char* find_crlf_scalar(const char* first, const char* last)
+{
+    for (; last - first >= 2; ++first)
+    {
+        if (first[0] == '\r' && first[1] == '\n')
+        {
+            return first;
+        }
+    }
+
+    return last;
+}
+
+const char* find_any_of_scalar(const char* first, const char* last,
+                               const char* set, std::size_t setLen)
+{
+    bool table[256] = {};
+    for (std::size_t i = 0; i < setLen; ++i)
+    {
+        table[static_cast<unsigned char>(set[i])] = true;
+    }
+
+    for (; first != last; ++first)
+    {
+        if (table[static_cast<unsigned char>(*first)])
+        {
+            return first;
+        }
+    }
+
+    return last;
+}
+
+#ifdef ASUKA_X86_64
+
+// SSE2 is always available on x86-64
+const char* find_crlf_sse2(const char* first, const char* last)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+
+    // compare 16 bytes with '\r' and the next 16 bytes with '\n'
+    while (last - first >= 17)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first + 1));
+        int mask = _mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(a, cr), _mm_cmpeq_epi8(b, lf)));
+        if (mask != 0)
+        {
+            return first + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+        first += 16;
+    }
+
+    return find_crlf_scalar(first, last);
+}
+
+const char* find_any_of_sse2(const char* first, const char* last,
+                             const char* set, std::size_t setLen)
+{
+    if (setLen > kMaxSimdSetSize)
+    {
+        return find_any_of_scalar(first, last, set, setLen);
+    }
+
+    __m128i needles[kMaxSimdSetSize];
+    for (std::size_t i = 0; i < setLen; ++i)
+    {
+        needles[i] = _mm_set1_epi8(set[i]);
+    }
+
+    while (last - first >= 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        __m128i eq = _mm_setzero_si128();
+        for (std::size_t i = 0; i < setLen; ++i)
+        {
+            eq = _mm_or_si128(eq, _mm_cmpeq_epi8(a, needles[i]));
+        }
+
+        int mask = _mm_movemask_epi8(eq);
+        if (mask != 0)
+        {
+            return first + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+        first += 16;
+    }
+
+    return find_any_of_scalar(first, last, set, setLen);
+}
+
+__attribute__((target("avx2")))
+const char* find_crlf_avx2(const char* first, const char* last)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+
+    while (last - first >= 33)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first + 1));
+        int mask = _mm256_movemask_epi8(_mm256_and_si256(
+            _mm256_cmpeq_epi8(a, cr), _mm256_cmpeq_epi8(b, lf)));
+        if (mask != 0)
+        {
+            return first + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+        first += 32;
+    }
+
+    return find_crlf_sse2(first, last);
+}
+
+__attribute__((target("avx2")))
+const char* find_any_of_avx2(const char* first, const char* last,
+                             const char* set, std::size_t setLen)
+{
+    if (setLen > kMaxSimdSetSize)
+    {
+        return find_any_of_scalar(first, last, set, setLen);
+    }
+
+    __m256i needles[kMaxSimdSetSize];
+    for (std::size_t i = 0; i < setLen; ++i)
+    {
+        needles[i] = _mm256_set1_epi8(set[i]);
+    }
+
+    while (last - first >= 32)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+        __m256i eq = _mm256_setzero_si256();
+        for (std::size_t i = 0; i < setLen; ++i)
+        {
+            eq = _mm256_or_si256(eq, _mm256_cmpeq_epi8(a, needles[i]));
+        }
+
+        int mask = _mm256_movemask_epi8(eq);
+        if (mask != 0)
+        {
+            return first + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+        first += 32;
+    }
+
+    return find_any_of_sse2(first, last, set, setLen);
+}
+
+bool has_avx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+FindCrlf select_find_crlf()
+{
+    return has_avx2() ? find_crlf_avx2 : find_crlf_sse2;
+}
+
+FindAnyOf select_find_any_of()
+{
+    return has_avx2() ? find_any_of_avx2 : find_any_of_sse2;
+}
+
+#else
+
+FindCrlf select_find_crlf()
+{
+    return find_crlf_scalar;
+}
+
+FindAnyOf select_find_any_of()
+{
+    return find_any_of_scalar;
+}
+
+#endif // ASUKA_X86_64
+
+} // unamed namespace
+
+const char* find_byte(const char* first, const char* last, char ch)
+{
+    // an empty range may be null, e.g. a buffer without storage,
+    // memchr must not be called with a null pointer
+    if (first == last)
+    {
+        return last;
+    }
+
+    // memchr of glibc has been vectorized and dispatched at runtime
+    const void* p = std::memchr(first, ch, last - first);
+    return p ? static_cast<const char*>(p) : last;
+}
+
+const char* find_crlf(const char* first, const char* last)
+{
+    static const FindCrlf func = select_find_crlf();
+    return func(first, last);
+}
+
+const char* find_any_of(const char* first, const char* last,
+                        const char* set, std::size_t setLen)
+{
+    static const FindAnyOf func = select_find_any_of();
+    return func(first, last, set, setLen);
+}
+
+} // namespace Asuka
\ No newline at end of file
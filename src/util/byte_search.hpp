@@ -0,0 +1,25 @@
+#pragma once
+#ifndef ASUKA_BYTE_SEARCH_HPP
+#define ASUKA_BYTE_SEARCH_HPP
+
+#include <cstddef>
+
+namespace Asuka
+{
+
+// delimiter search in [first, last), return `last` if not found
+// on x86-64, AVX2 or SSE2 is chosen at runtime, else scalar code is used
+
+// find the byte `ch`
+const char* find_byte(const char* first, const char* last, char ch);
+
+// find "\r\n", return the pointer to '\r'
+const char* find_crlf(const char* first, const char* last);
+
+// find any byte of [set, set + setLen)
+const char* find_any_of(const char* first, const char* last,
+                        const char* set, std::size_t setLen);
+
+} // namespace Asuka
+
+#endif // ASUKA_BYTE_SEARCH_HPP
\ No newline at end of file
@@ -17,7 +17,7 @@ const std::array<Any, Config::kNumberConfig> Config::kDefaultConfig
 {
     Any{ static_cast<std::uint16_t>(8888) },    // port
     Any{ 0 },                                   // number of thread[s]
-    Any{ false },                               // use epoll
+    Any{ PollerType::POLL },                    // use poll
     Any{ std::string{""} }                      // path of logging file
 }
 };
@@ -40,7 +40,12 @@ int Config::get_threads() const
 
 bool Config::get_use_epoll() const
 {
-    return any_cast<bool>(mConfig[kUseIndex]);
+    return get_poller_type() == PollerType::EPOLL;
+}
+
+PollerType Config::get_poller_type() const
+{
+    return any_cast<PollerType>(mConfig[kUseIndex]);
 }
 
 std::string Config::get_log_file() const
@@ -158,17 +163,21 @@ void Config::parse_line(const std::string& line, std::size_t curLine)
     case 'u':   // use
     {
         value = parse_value(line, idx, "use", 3, curLine);
-        bool useEpoll = false;
+        PollerType type = PollerType::POLL;
         if (value == "epoll")
         {
-            useEpoll = true;
+            type = PollerType::EPOLL;
+        }
+        else if (value == "io_uring")
+        {
+            type = PollerType::IO_URING;
         }
         else if (value != "poll")
         {
             err_quit("check use config at line %zu", curLine);
         }
 
-        mConfig[kUseIndex] = useEpoll;
+        mConfig[kUseIndex] = type;
         break;
     }
     case 'l':   // logfile
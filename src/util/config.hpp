@@ -11,6 +11,14 @@
 namespace Asuka
 {
 
+// `use` in the configuration file
+enum class PollerType
+{
+    POLL,
+    EPOLL,
+    IO_URING
+};
+
 // singleton class
 class Config : Noncopyable
 {
@@ -35,6 +43,8 @@ public:
 
     bool get_use_epoll() const;
 
+    PollerType get_poller_type() const;
+
     std::string get_log_file() const;
 private:
     Config();
@@ -46,7 +56,7 @@ private:
 private:
     // short port
     // int threads
-    // bool useEpoll 
+    // PollerType use
     // string logFile
     std::array<Any, kNumberConfig> mConfig;
 };
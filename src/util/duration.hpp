@@ -87,6 +87,12 @@ public:
         return Duration{};
     }
 
+    static Duration from_seconds(double seconds)
+    {
+        return Duration{ static_cast<std::int64_t>(
+            seconds * static_cast<double>(kSecond)) };
+    }
+
     Duration& operator+=(const Duration& rhs)
     {
         mUs += rhs.mUs;
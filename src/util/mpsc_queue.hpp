@@ -0,0 +1,235 @@
+#pragma once
+#ifndef ASUKA_MPSC_QUEUE_HPP
+#define ASUKA_MPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "noncopyable.hpp"
+
+namespace Asuka
+{
+
+// reference the unbounded SegQueue of crossbeam
+// https://github.com/crossbeam-rs/crossbeam/blob/master/crossbeam-queue/src/seg_queue.rs
+//
+// lock free multi-producer single-consumer queue, the values are kept in
+// slots of blocks linked in push order, so a push claims a slot by one
+// compare-and-swap and the consumer reads the slots in order
+//
+// mTailIndex counts the claimed positions, every kLap positions make a
+// block, the last position of a lap is not a slot, it marks the block is
+// full while the push taking the last slot links the next block
+// the positions only grow, so a push with a stale position or block fails
+// its compare-and-swap and tries again
+// a push constructs the value in the claimed slot, then marks it ready,
+// the consumer stops at a slot not ready yet
+// the consumer keeps an emptied block for the next block linked,
+// so a push only allocates when the queue grows
+//
+// push never locks, but may wait for another push linking a block
+// pop and consume must be called by only one thread at the same time
+// T must be move constructible
+template <typename T>
+class MpscQueue : Noncopyable
+{
+public:
+    MpscQueue()
+        : mTailIndex(0),
+          mTailBlock(new Block),
+          mSpareBlock(nullptr),
+          mHeadBlock(mTailBlock.load(std::memory_order_relaxed)),
+          mHeadOffset(0),
+          mPopped(0)
+    {
+    }
+
+    ~MpscQueue()
+    {
+        while (consume([](T&) {}))
+        {
+        }
+
+        delete mHeadBlock;
+        delete mSpareBlock.load(std::memory_order_relaxed);
+    }
+
+    void push(T value)
+    {
+        Block* next = nullptr;
+        std::uint64_t tail = mTailIndex.load(std::memory_order_acquire);
+        Block* block = mTailBlock.load(std::memory_order_acquire);
+        std::uint32_t offset = 0;
+        for (;;)
+        {
+            offset = static_cast<std::uint32_t>(tail % kLap);
+            if (offset == kBlockSize)
+            {
+                // another push is linking the next block
+                std::this_thread::yield();
+                tail = mTailIndex.load(std::memory_order_acquire);
+                block = mTailBlock.load(std::memory_order_acquire);
+                continue;
+            }
+
+            // get the next block before taking the last slot, so the
+            // other pushes wait as short as possible
+            if (offset + 1 == kBlockSize && next == nullptr)
+            {
+                next = take_block();
+            }
+
+            if (mTailIndex.compare_exchange_weak(tail, tail + 1,
+                std::memory_order_acquire, std::memory_order_acquire))
+            {
+                break;
+            }
+
+            block = mTailBlock.load(std::memory_order_acquire);
+        }
+
+        if (offset + 1 == kBlockSize)
+        {
+            mTailBlock.store(next, std::memory_order_release);
+            mTailIndex.store(tail + 2, std::memory_order_release);
+            // linked before the last slot is ready, so the consumer
+            // finds the next block after the last slot
+            block->mNext.store(next, std::memory_order_release);
+        }
+        else if (next != nullptr)
+        {
+            keep_block(next);
+        }
+
+        Slot& slot = block->mSlots[offset];
+        ::new (slot.value()) T(std::move(value));
+        slot.mReady.store(true, std::memory_order_release);
+    }
+
+    // consumer only, return false if no element can be taken now
+    bool pop(T& value)
+    {
+        return consume([&value](T& front) { value = std::move(front); });
+    }
+
+    // consumer only, call `visit` with the front element in place, then
+    // destroy it, which saves moving it out
+    // return false if no element can be taken now
+    template <typename Visitor>
+    bool consume(Visitor&& visit)
+    {
+        Block* block = mHeadBlock;
+        Slot& slot = block->mSlots[mHeadOffset];
+        if (!slot.mReady.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        slot.mReady.store(false, std::memory_order_relaxed);
+        // only the consumer writes mPopped, no read-modify-write needed
+        mPopped.store(mPopped.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+        if (++mHeadOffset == kBlockSize)
+        {
+            // the push of the last slot linked the next block
+            mHeadBlock = block->mNext.load(std::memory_order_acquire);
+            mHeadOffset = 0;
+        }
+
+        visit(*slot.value());
+        slot.value()->~T();
+        if (mHeadOffset == 0)
+        {
+            block->mNext.store(nullptr, std::memory_order_relaxed);
+            keep_block(block);
+        }
+        return true;
+    }
+
+    // approximate when producers are pushing
+    std::size_t size() const
+    {
+        // a value is popped after its position is claimed,
+        // read mPopped first so it never passes the pushed count
+        std::size_t popped = mPopped.load(std::memory_order_relaxed);
+        std::uint64_t tail = mTailIndex.load(std::memory_order_relaxed);
+        std::uint64_t offset = tail % kLap;
+        std::size_t pushed = static_cast<std::size_t>(tail / kLap * kBlockSize
+            + (offset < kBlockSize ? offset : kBlockSize));
+        return pushed - popped;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+private:
+    // the positions of a block, the slots and the mark of a full block
+    static const std::uint32_t kLap = 256;
+    static const std::uint32_t kBlockSize = kLap - 1;
+
+    struct Slot
+    {
+        Slot()
+            : mReady(false)
+        {
+        }
+
+        T* value()
+        {
+            return reinterpret_cast<T*>(&mStorage);
+        }
+
+        // set when the value is constructed, cleared when it is popped
+        std::atomic<bool> mReady;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type mStorage;
+    };
+
+    struct Block
+    {
+        Block()
+            : mNext(nullptr)
+        {
+        }
+
+        Slot mSlots[kBlockSize];
+        std::atomic<Block*> mNext;
+    };
+
+    // producers, the kept block or a new one
+    Block* take_block()
+    {
+        Block* block = mSpareBlock.exchange(nullptr, std::memory_order_acquire);
+        return block != nullptr ? block : new Block;
+    }
+
+    // keep an empty block for the next take_block, one at most
+    void keep_block(Block* block)
+    {
+        delete mSpareBlock.exchange(block, std::memory_order_acq_rel);
+    }
+
+    static const std::size_t kCacheLineSize = 64;
+
+private:
+    // producers side
+    std::atomic<std::uint64_t> mTailIndex;
+    std::atomic<Block*> mTailBlock;
+    std::atomic<Block*> mSpareBlock;
+    char mPadding[kCacheLineSize];
+
+    // consumer side
+    Block* mHeadBlock;
+    std::uint32_t mHeadOffset;
+    std::atomic<std::size_t> mPopped;
+};
+
+} // namespace Asuka
+
+#endif // ASUKA_MPSC_QUEUE_HPP
\ No newline at end of file
@@ -0,0 +1,231 @@
+#pragma once
+#ifndef ASUKA_TASK_HPP
+#define ASUKA_TASK_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Asuka
+{
+
+// move-only `void()` callable, like std::function without copying
+// a callable up to kInlineSize bytes is stored in the object itself,
+// e.g. std::bind with a shared_ptr and a std::string, so it does not
+// allocate, a larger one is stored on the heap
+class Task
+{
+public:
+    static const std::size_t kInlineSize = 112;
+
+public:
+    Task() noexcept
+        : mOps(nullptr)
+    {
+    }
+
+    Task(std::nullptr_t) noexcept
+        : mOps(nullptr)
+    {
+    }
+
+    template <typename F, typename = typename std::enable_if<
+        !std::is_same<typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& f)
+        : mOps(nullptr)
+    {
+        using Func = typename std::decay<F>::type;
+        if (!is_null(f))
+        {
+            construct<Func>(std::forward<F>(f), IsInline<Func>{});
+        }
+    }
+
+    Task(Task&& rhs) noexcept
+        : mOps(rhs.mOps)
+    {
+        if (mOps)
+        {
+            mOps->move(&mStorage, &rhs.mStorage);
+            rhs.mOps = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            reset();
+            if (rhs.mOps)
+            {
+                rhs.mOps->move(&mStorage, &rhs.mStorage);
+                mOps = rhs.mOps;
+                rhs.mOps = nullptr;
+            }
+        }
+
+        return *this;
+    }
+
+    Task& operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task()
+    {
+        reset();
+    }
+
+    void operator()() const
+    {
+        assert(mOps);
+        mOps->invoke(&mStorage);
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return mOps != nullptr;
+    }
+
+    // whether the callable is stored without allocating
+    bool is_inline() const noexcept
+    {
+        return mOps != nullptr && mOps->isInline;
+    }
+
+private:
+    using Storage = typename std::aligned_storage<kInlineSize,
+        alignof(std::max_align_t)>::type;
+
+    struct Ops
+    {
+        void (*invoke)(void* storage);
+        // move construct `dst` from `src` and destroy `src`
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void* storage);
+        bool isInline;
+    };
+
+    template <typename F>
+    using IsInline = std::integral_constant<bool,
+        sizeof(F) <= kInlineSize
+        && alignof(F) <= alignof(std::max_align_t)
+        && std::is_nothrow_move_constructible<F>::value>;
+
+    template <typename F>
+    struct InlineOps
+    {
+        static void invoke(void* storage)
+        {
+            (*static_cast<F*>(storage))();
+        }
+
+        static void move(void* dst, void* src)
+        {
+            F* f = static_cast<F*>(src);
+            ::new (dst) F(std::move(*f));
+            f->~F();
+        }
+
+        static void destroy(void* storage)
+        {
+            static_cast<F*>(storage)->~F();
+        }
+
+        static const Ops kOps;
+    };
+
+    template <typename F>
+    struct HeapOps
+    {
+        static void invoke(void* storage)
+        {
+            (**static_cast<F**>(storage))();
+        }
+
+        static void move(void* dst, void* src)
+        {
+            *static_cast<F**>(dst) = *static_cast<F**>(src);
+        }
+
+        static void destroy(void* storage)
+        {
+            delete *static_cast<F**>(storage);
+        }
+
+        static const Ops kOps;
+    };
+
+    template <typename Func, typename F>
+    void construct(F&& f, std::true_type)
+    {
+        ::new (&mStorage) Func(std::forward<F>(f));
+        mOps = &InlineOps<Func>::kOps;
+    }
+
+    template <typename Func, typename F>
+    void construct(F&& f, std::false_type)
+    {
+        *reinterpret_cast<Func**>(&mStorage) = new Func(std::forward<F>(f));
+        mOps = &HeapOps<Func>::kOps;
+    }
+
+    template <typename F>
+    static bool is_null(const F&)
+    {
+        return false;
+    }
+
+    template <typename R, typename... Args>
+    static bool is_null(R (* const& f)(Args...))
+    {
+        return f == nullptr;
+    }
+
+    template <typename Sig>
+    static bool is_null(const std::function<Sig>& f)
+    {
+        return !f;
+    }
+
+    void reset() noexcept
+    {
+        if (mOps)
+        {
+            mOps->destroy(&mStorage);
+            mOps = nullptr;
+        }
+    }
+
+private:
+    mutable Storage mStorage;
+    const Ops* mOps;
+};
+
+template <typename F>
+const Task::Ops Task::InlineOps<F>::kOps = {
+    &Task::InlineOps<F>::invoke,
+    &Task::InlineOps<F>::move,
+    &Task::InlineOps<F>::destroy,
+    true
+};
+
+template <typename F>
+const Task::Ops Task::HeapOps<F>::kOps = {
+    &Task::HeapOps<F>::invoke,
+    &Task::HeapOps<F>::move,
+    &Task::HeapOps<F>::destroy,
+    false
+};
+
+} // namespace Asuka
+
+#endif // ASUKA_TASK_HPP
\ No newline at end of file
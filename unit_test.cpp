@@ -1,17 +1,37 @@
-﻿#include <iostream>
+﻿#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <typeinfo>
+#include <vector>
 
 #include "src/util/any.hpp"
 #include "src/util/block_queue.hpp"
+#include "src/util/byte_search.hpp"
 #include "src/util/config.hpp"
 #include "src/util/json.hpp"
 #include "src/util/logger.hpp"
+#include "src/util/mpsc_queue.hpp"
 #include "src/util/string_view.hpp"
+#include "src/util/task.hpp"
 #include "src/util/time_stamp.hpp"
 
+#include "src/net/buffer_pool.hpp"
+#include "src/net/channel.hpp"
 #include "src/net/event_loop.hpp"
 #include "src/net/event_loop_thread.hpp"
+#include "src/net/output_queue.hpp"
 #include "src/net/tcp_client.hpp"
+#include "src/net/tcp_connection.hpp"
 #include "src/net/tcp_server.hpp"
 
 using namespace Asuka;
@@ -194,6 +214,232 @@ void test_time_stamp()
 }
 
 
+void test_byte_search()
+{
+    // cover the SIMD blocks and the scalar tail
+    for (std::size_t len = 2; len < 100; ++len)
+    {
+        for (std::size_t pos = 0; pos + 1 < len; pos += 7)
+        {
+            std::string str(len, 'a');
+            str[pos] = '\r';
+            str[pos + 1] = '\n';
+            const char* first = str.data();
+            const char* last = first + str.size();
+            auto offset = [first](const char* p) 
+                { return static_cast<std::size_t>(p - first); };
+
+            UNIT_TEST(pos, offset(find_crlf(first, last)));
+            UNIT_TEST(pos, offset(find_byte(first, last, '\r')));
+            UNIT_TEST(pos, offset(find_any_of(first, last, "x\n\r", 3)));
+            UNIT_TEST(pos + 1, offset(find_any_of(first, last, "\n", 1)));
+            UNIT_TEST(len, offset(find_any_of(first, last, "xyz", 3)));
+        }
+
+        // '\r' at the end of a block without '\n'
+        std::string str(len, '\r');
+        UNIT_TEST(true, find_crlf(str.data(), str.data() + len) == str.data() + len);
+    }
+
+    std::string large(64, 'a');
+    large += ';';
+    std::string set = "0123456789!@#$%^&*();";     // larger than a SIMD set
+    UNIT_TEST(true, find_any_of(large.data(), large.data() + large.size(), 
+        set.data(), set.size()) == large.data() + 64);
+
+    // an empty range, null like a buffer without storage
+    UNIT_TEST(true, find_byte(nullptr, nullptr, '\n') == nullptr);
+    UNIT_TEST(true, find_crlf(nullptr, nullptr) == nullptr);
+    Buffer unset{ Buffer::NoStorage{} };
+    UNIT_TEST(true, unset.find_eol() == nullptr);
+}
+
+void test_buffer()
+{
+    Buffer buf;
+    buf.append("abc", 3);
+    UNIT_TEST(3, buf.readable_bytes());
+    buf.retrieve_all();
+
+    // resumable search does not rescan the prefix
+    std::size_t scanned = 0;
+    buf.append("GET / HTTP/1.1\r", 15);
+    UNIT_TEST(true, buf.find_crlf_from(scanned) == nullptr);
+    UNIT_TEST(15, scanned);
+    buf.append("\nHost", 5);
+    UNIT_TEST(true, buf.find_crlf_from(scanned) == buf.peek() + 14);
+    UNIT_TEST(true, buf.find_eol_from(scanned) == buf.peek() + 15);
+    UNIT_TEST(true, buf.find_any_of(" /") == buf.peek() + 3);
+    buf.retrieve_all();
+
+    // net endian integers
+    buf.append_uint32(0x01020304);
+    buf.append_uint16(0xfffe);
+    buf.append_uint64(42);
+    buf.append_uint8(7);
+    UNIT_TEST(1, *buf.peek());
+    UNIT_TEST(0x01020304, buf.peek_int32());
+    UNIT_TEST(0x01020304, buf.read_int32());
+    UNIT_TEST(-2, buf.read_int16());
+    UNIT_TEST(42, buf.read_int64());
+    UNIT_TEST(7, buf.peek_int8());
+    UNIT_TEST(7, buf.read_int8());
+    UNIT_TEST(0, buf.readable_bytes());
+
+    // length-prefixed framing in place
+    buf.append("body", 4);
+    buf.prepend_int32(4);
+    UNIT_TEST(8, buf.readable_bytes());
+    UNIT_TEST(4, buf.read_int32());
+    UNIT_TEST("body", buf.retrieve_all_as_string());
+
+    // shrink keeps the readable bytes and frees the rest
+    Buffer large(64 * 1024);
+    large.append("keep", 4);
+    large.shrink(16);
+    UNIT_TEST(true, large.capacity() < 1024);
+    UNIT_TEST(16, large.writable_bytes());
+    UNIT_TEST("keep", large.retrieve_all_as_string());
+
+    // configurable headroom
+    Buffer framed(64, 16);
+    UNIT_TEST(16, framed.get_prepend_size());
+    UNIT_TEST(16, framed.prepend_bytes());
+    framed.append("payload", 7);
+    framed.prepend(":", 1);
+    framed.prepend("hdr", 3);
+    framed.prepend_int64(11);
+    UNIT_TEST(4, framed.prepend_bytes());
+    UNIT_TEST(11, framed.read_int64());
+    UNIT_TEST("hdr:payload", framed.retrieve_all_as_string());
+    UNIT_TEST(16, framed.prepend_bytes());
+    framed.append(std::string(200, 'x'));
+    framed.retrieve(100);
+    framed.ensure_writable_bytes(50);
+    UNIT_TEST(16, framed.prepend_bytes());
+    Buffer movedFramed(std::move(framed));
+    UNIT_TEST(16, movedFramed.get_prepend_size());
+
+    // a buffer without storage allocates again when appending
+    BufferPool pool;
+    std::vector<char> storage = buf.release_storage();
+    UNIT_TEST(false, buf.has_storage());
+    UNIT_TEST(0, buf.readable_bytes());
+    UNIT_TEST(0, buf.writable_bytes());
+    buf.retrieve_all();
+    buf.append("hello", 5);
+    UNIT_TEST(true, buf.has_storage());
+    UNIT_TEST("hello", buf.retrieve_all_as_string());
+
+    pool.release(buf.release_storage());
+    UNIT_TEST(0, pool.free_blocks());     // not a pool block
+    buf.adopt_storage(pool.acquire());
+    UNIT_TEST(BufferPool::kBlockSize, buf.size());
+    buf.append("world", 5);
+    UNIT_TEST("world", buf.retrieve_all_as_string());
+    pool.release(buf.release_storage());
+    UNIT_TEST(1, pool.free_blocks());
+
+    Buffer empty{ Buffer::NoStorage{} };
+    UNIT_TEST(false, empty.has_storage());
+    UNIT_TEST(0, empty.size());
+    UNIT_TEST(true, empty.begin() == empty.end());
+    empty.append("abc", 3);
+    UNIT_TEST(8, empty.prepend_bytes());
+    UNIT_TEST("abc", empty.retrieve_all_as_string());
+}
+
+void test_output_queue()
+{
+    int fds[2];
+    UNIT_TEST(0, ::pipe(fds));
+
+    OutputQueue queue;
+    UNIT_TEST(true, queue.empty());
+
+    std::string large(100 * 1024, 'x');
+    queue.append("abc", 3);
+    queue.append(large);
+    queue.append(StringView{ "def" });
+    UNIT_TEST(large.size() + 6, queue.readable_bytes());
+    UNIT_TEST(2, queue.chunk_count());
+
+    // keep 16 'x' + "def"
+    queue.retrieve(3);
+    queue.retrieve(large.size() - 16);
+    UNIT_TEST(19, queue.readable_bytes());
+    UNIT_TEST(1, queue.chunk_count());
+
+    int savedError = 0;
+    ssize_t n = queue.write_fd(fds[1], savedError);
+    UNIT_TEST(19, n);
+    UNIT_TEST(true, queue.empty());
+    UNIT_TEST(0, queue.chunk_count());
+
+    char buf[32] = {};
+    UNIT_TEST(19, ::read(fds[0], buf, sizeof(buf)));
+    UNIT_TEST(std::string(16, 'x') + "def", std::string(buf, 19));
+
+    // shared payload is queued by reference
+    SharedPayload payload = std::make_shared<const std::string>("shared");
+    queue.append("<", 1);
+    queue.append(payload, 2);
+    queue.append(payload);
+    queue.append(">", 1);
+    UNIT_TEST(3, payload.use_count());
+    UNIT_TEST(4, queue.chunk_count());
+    UNIT_TEST(12, queue.readable_bytes());
+
+    n = queue.write_fd(fds[1], savedError);
+    UNIT_TEST(12, n);
+    UNIT_TEST(1, payload.use_count());
+    UNIT_TEST(12, ::read(fds[0], buf, sizeof(buf)));
+    UNIT_TEST("<aredshared>", std::string(buf, 12));
+
+    // moved string and buffer are queued without copying
+    std::string moved(1000, 'm');
+    Buffer movedBuffer;
+    movedBuffer.append("buffer", 6);
+    queue.append(std::move(moved), 990);
+    queue.append(std::move(movedBuffer));
+    UNIT_TEST(2, queue.chunk_count());
+    n = queue.write_fd(fds[1], savedError);
+    UNIT_TEST(16, n);
+    UNIT_TEST(16, ::read(fds[0], buf, sizeof(buf)));
+    UNIT_TEST(std::string(10, 'm') + "buffer", std::string(buf, 16));
+
+    // file region is written by sendfile(2) in order
+    char path[] = "/tmp/asuka_unit_test_XXXXXX";
+    int filefd = ::mkstemp(path);
+    UNIT_TEST(true, filefd >= 0);
+    UNIT_TEST(10, ::write(filefd, "0123456789", 10));
+    queue.append("[", 1);
+    queue.append_file(filefd, 2, 5);
+    queue.append("]", 1);
+    UNIT_TEST(7, queue.readable_bytes());
+
+    while (!queue.empty() && queue.write_fd(fds[1], savedError) > 0)
+    {
+    }
+    UNIT_TEST(7, ::read(fds[0], buf, sizeof(buf)));
+    UNIT_TEST("[23456]", std::string(buf, 7));
+    ::close(filefd);
+    ::unlink(path);
+
+    // a small message gets a small chunk, the next chunk is larger
+    OutputQueue small;
+    small.append("abc", 3);
+    small.append(StringView{ std::string(1000, 's') });
+    UNIT_TEST(1, small.chunk_count());
+    small.append(StringView{ std::string(100, 's') });
+    UNIT_TEST(2, small.chunk_count());
+    small.append(StringView{ std::string(1900, 's') });
+    UNIT_TEST(2, small.chunk_count());
+    UNIT_TEST(3003, small.readable_bytes());
+
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
 
 void test_null()
 {
@@ -476,11 +722,1093 @@ void test_json()
     test_error();
 }
 
+void test_mpsc_queue()
+{
+    MpscQueue<int> queue;
+    int value = 0;
+    UNIT_TEST(true, queue.empty());
+    UNIT_TEST(false, queue.pop(value));
+    queue.push(1);
+    queue.push(2);
+    UNIT_TEST(2, queue.size());
+    UNIT_TEST(true, queue.pop(value));
+    UNIT_TEST(1, value);
+    UNIT_TEST(true, queue.pop(value));
+    UNIT_TEST(2, value);
+    UNIT_TEST(false, queue.pop(value));
+
+    // every producer's values are popped once and in order
+    const int kProducers = 4;
+    const int kPerProducer = 100000;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; ++p)
+    {
+        producers.emplace_back([&queue, p, kPerProducer]() {
+            for (int i = 0; i < kPerProducer; ++i)
+            {
+                queue.push(p * kPerProducer + i);
+            }
+        });
+    }
+
+    std::vector<int> next(kProducers, 0);
+    int popped = 0;
+    bool ordered = true;
+    while (popped < kProducers * kPerProducer)
+    {
+        if (!queue.pop(value))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        int p = value / kPerProducer;
+        ordered = ordered && value % kPerProducer == next[p];
+        ++next[p];
+        ++popped;
+    }
+
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+
+    UNIT_TEST(true, ordered);
+    UNIT_TEST(true, queue.empty());
+    UNIT_TEST(false, queue.pop(value));
+
+    // more values than a block, the blocks are reused after popping
+    for (int round = 0; round < 2; ++round)
+    {
+        for (int i = 0; i < 1000; ++i)
+        {
+            queue.push(i);
+        }
+        UNIT_TEST(1000, queue.size());
+
+        int expect = 0;
+        while (queue.pop(value) && value == expect)
+        {
+            ++expect;
+        }
+        UNIT_TEST(1000, expect);
+    }
+
+    // consume uses the value in place and destroys it after
+    MpscQueue<std::shared_ptr<int>> pointers;
+    auto pointer = std::make_shared<int>(7);
+    pointers.push(pointer);
+    UNIT_TEST(2, pointer.use_count());
+    int seen = 0;
+    UNIT_TEST(true, pointers.consume([&seen](std::shared_ptr<int>& p)
+    {
+        seen = *p;
+    }));
+    UNIT_TEST(7, seen);
+    UNIT_TEST(1, pointer.use_count());
+    UNIT_TEST(false, pointers.consume([](std::shared_ptr<int>&) {}));
+
+    // the queue frees the remaining values
+    MpscQueue<std::string> strings;
+    strings.push(std::string(100, 'x'));
+    for (int i = 0; i < 300; ++i)
+    {
+        strings.push(std::to_string(i));
+    }
+}
+void test_task()
+{
+    Task empty;
+    UNIT_TEST(false, static_cast<bool>(empty));
+    UNIT_TEST(false, static_cast<bool>(Task{ std::function<void()>{} }));
+    void (*nullFunc)() = nullptr;
+    UNIT_TEST(false, static_cast<bool>(Task{ nullFunc }));
+
+    int count = 0;
+    Task task{ [&count]() { ++count; } };
+    UNIT_TEST(true, task.is_inline());
+    task();
+    task();
+    UNIT_TEST(2, count);
+
+    // the common cross-thread pattern does not allocate
+    auto owner = std::make_shared<int>(0);
+    std::string got;
+    Task bound{ std::bind([&got](const std::string& str, std::shared_ptr<int>)
+        { got = str; }, std::string(64, 'x'), owner) };
+    UNIT_TEST(true, bound.is_inline());
+    UNIT_TEST(2, owner.use_count());
+
+    Task moved{ std::move(bound) };
+    UNIT_TEST(false, static_cast<bool>(bound));
+    UNIT_TEST(2, owner.use_count());
+    moved();
+    UNIT_TEST(64, got.size());
+    moved = nullptr;
+    UNIT_TEST(1, owner.use_count());
+
+    // move-only and large callables
+    std::unique_ptr<int> uptr{ new int{ 7 } };
+    Task moveOnly{ std::bind([&count](std::unique_ptr<int>& p) { count = *p; },
+        std::move(uptr)) };
+    moveOnly();
+    UNIT_TEST(7, count);
+
+    char large[256] = { 1 };
+    Task heap{ [large, &count, owner]() { count = large[0]; } };
+    UNIT_TEST(false, heap.is_inline());
+    UNIT_TEST(2, owner.use_count());
+    task = std::move(heap);
+    task();
+    UNIT_TEST(1, count);
+    task = Task{};
+    UNIT_TEST(1, owner.use_count());
+}
+
+void test_event_loop()
+{
+    EventLoopThread loopThread;
+    EventLoop* loop = loopThread.startLoop();
+
+    // posts from a foreign thread share the pending wakeups
+    const int kPosts = 1000;
+    std::atomic<int> ran(0);
+    for (int i = 0; i < kPosts; ++i)
+    {
+        loop->queue_in_loop([&ran]() { ++ran; });
+    }
+
+    while (ran < kPosts)
+    {
+        std::this_thread::yield();
+    }
+
+    UNIT_TEST(true, loop->get_stats().wakeupsIssued >= 1);
+    UNIT_TEST(kPosts, loop->get_stats().wakeupsIssued + loop->get_stats().wakeupsSuppressed);
+
+    // a function queued after draining wakes up the loop again
+    std::uint64_t issued = loop->get_stats().wakeupsIssued;
+    loop->queue_in_loop([&ran]() { ++ran; });
+    while (ran < kPosts + 1)
+    {
+        std::this_thread::yield();
+    }
+    UNIT_TEST(issued + 1, loop->get_stats().wakeupsIssued);
+
+    // timers added from a foreign thread
+    std::atomic<int> fired(0);
+    std::atomic<int> repeated(0);
+    loop->run_after(0.02, [&fired]() { fired += 1; });
+    loop->run_after(0.01, [&fired]() { fired += 10; });
+    TimerId timerid = loop->run_interval(0.001, [&repeated]() { ++repeated; });
+    TimerId canceled = loop->run_after(0.005, [&fired]() { fired += 100; });
+    loop->cancel_timer(canceled);
+
+    while (fired < 11 || repeated < 3)
+    {
+        std::this_thread::yield();
+    }
+    loop->cancel_timer(timerid);
+
+    UNIT_TEST(11, fired);
+
+    // at most 2 pending functions per iteration
+    std::atomic<bool> blocking(false);
+    std::atomic<bool> blocked(true);
+    loop->queue_in_loop([loop, &blocking, &blocked]() 
+    { 
+        loop->set_task_budget(2, 0);
+        blocking = true;
+        while (blocked)
+        {
+            std::this_thread::yield();
+        }
+    });
+    while (!blocking)
+    {
+        std::this_thread::yield();
+    }
+
+    const int kBudgetPosts = 7;
+    std::vector<std::uint64_t> iterations;
+    for (int i = 0; i < kBudgetPosts; ++i)
+    {
+        loop->queue_in_loop([loop, &iterations]() 
+            { iterations.push_back(loop->iteration()); });
+    }
+    std::atomic<bool> done(false);
+    loop->queue_in_loop([&done]() { done = true; });
+    blocked = false;
+
+    while (!done)
+    {
+        std::this_thread::yield();
+    }
+
+    UNIT_TEST(static_cast<std::size_t>(kBudgetPosts), iterations.size());
+    bool withinBudget = true;
+    for (std::size_t i = 2; i < iterations.size(); ++i)
+    {
+        withinBudget = withinBudget && iterations[i] > iterations[i - 2];
+    }
+    UNIT_TEST(true, withinBudget);
+    loop->queue_in_loop([loop]() { loop->set_task_budget(0, 0); });
+
+    // spin after an event, then block again
+    loop->queue_in_loop([loop]() 
+    { 
+        loop->set_poll_timeout(100);
+        loop->set_busy_poll(100 * 1000);
+    });
+    loop->queue_in_loop([]() {});
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::uint64_t spinning = loop->iteration();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    UNIT_TEST(true, loop->iteration() - spinning > 10);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    std::uint64_t idle = loop->iteration();
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    UNIT_TEST(true, loop->iteration() - idle <= 2);
+    UNIT_TEST(100, loop->get_poll_timeout());
+
+    EventLoop::Stats stats = loop->get_stats();
+    std::uint64_t histogramTotal = 0;
+    for (std::uint64_t bucket : stats.eventsHistogram)
+    {
+        histogramTotal += bucket;
+    }
+    // the loop may be running, allow one iteration off
+    UNIT_TEST(true, histogramTotal + 1 >= stats.iterations
+        && histogramTotal <= stats.iterations + 1);
+    UNIT_TEST(true, stats.eventsHistogram[0] > 0);  // spinning
+    UNIT_TEST(true, stats.eventsHistogram[1] > 0);  // woken up
+    UNIT_TEST(true, stats.tasksRun >= static_cast<std::uint64_t>(kPosts));
+    UNIT_TEST(true, stats.timersFired >= 5);
+    UNIT_TEST(2, stats.channels);    // wakeup fd and timer fd
+    UNIT_TEST(true, stats.pollWaitUs > 100 * 1000);
+    UNIT_TEST(0, stats.slowHandlers);
+
+    // a read callback slower than the threshold is reported
+    int pipefd[2];
+    UNIT_TEST(0, ::pipe(pipefd));
+    std::unique_ptr<Channel> channel;
+    std::atomic<bool> handled(false);
+    loop->queue_in_loop([&]()
+    {
+        loop->set_slow_handler_threshold(1000);
+        channel.reset(new Channel{ loop, pipefd[0] });
+        channel->set_name("slow pipe");
+        channel->set_read_callback([&](TimeStamp)
+        {
+            char c;
+            UNIT_TEST(1, ::read(pipefd[0], &c, 1));
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            handled = true;
+        });
+        channel->enable_read();
+    });
+    UNIT_TEST(1, ::write(pipefd[1], "x", 1));
+    while (!handled)
+    {
+        std::this_thread::yield();
+    }
+
+    std::atomic<bool> removed(false);
+    loop->queue_in_loop([&]()
+    {
+        channel->disable_all();
+        channel->remove();
+        channel.reset();
+        loop->set_slow_handler_threshold(0);
+        removed = true;
+    });
+    while (!removed)
+    {
+        std::this_thread::yield();
+    }
+    ::close(pipefd[0]);
+    ::close(pipefd[1]);
+    UNIT_TEST(1, loop->get_stats().slowHandlers);
+}
+void test_timing_wheel()
+{
+    EventLoop loop{ PollerType::EPOLL };
+    loop.set_timing_wheel(0.001);
+
+    TimeStamp start = TimeStamp::now();
+    std::vector<int> order;
+    std::int64_t elapsed5 = 0;
+    std::int64_t elapsed300 = 0;
+    loop.run_after(0.3, [&]()
+    {
+        // cascaded from level 1
+        order.push_back(300);
+        elapsed300 = (TimeStamp::now() - start).to_microseconds();
+        loop.quit();
+    });
+    loop.run_after(0.005, [&]()
+    {
+        order.push_back(5);
+        elapsed5 = (TimeStamp::now() - start).to_microseconds();
+    });
+    TimerId canceled = loop.run_after(0.01, [&]() { order.push_back(10); });
+    loop.cancel_timer(canceled);
+
+    // canceled in its own callback
+    int repeated = 0;
+    TimerId interval;
+    interval = loop.run_interval(0.002, [&]()
+    {
+        if (++repeated == 3)
+        {
+            loop.cancel_timer(interval);
+        }
+    });
+
+    // still in the timer queue
+    bool precise = false;
+    loop.run_at(TimeStamp::now() + Duration::from_seconds(0.02), 
+        [&precise]() { precise = true; });
+
+    loop.loop();
+
+    UNIT_TEST(true, order == std::vector<int>({ 5, 300 }));
+    UNIT_TEST(true, elapsed5 >= 5000);
+    UNIT_TEST(true, elapsed300 >= 300000 && elapsed300 < 1000000);
+    UNIT_TEST(3, repeated);
+    UNIT_TEST(true, precise);
+    UNIT_TEST(6, loop.get_stats().timersFired);
+}
+
+void test_reset_timer(bool isWheel)
+{
+    EventLoop loop{ PollerType::EPOLL };
+    if (isWheel)
+    {
+        loop.set_timing_wheel(0.001);
+    }
+
+    TimeStamp start = TimeStamp::now();
+    std::vector<int> order;
+    std::vector<std::int64_t> elapsed;
+    auto record = [&](int id)
+    {
+        order.push_back(id);
+        elapsed.push_back((TimeStamp::now() - start).to_microseconds());
+    };
+
+    // hours away, set as the earliest before the others are added,
+    // the delay does not fit an int of microseconds
+    TimerId far = loop.run_after(3600, [&]() { record(1); });
+    loop.extend_timer(far, 7200);
+    TimerId farInterval = loop.run_interval(3600, [&]() { record(2); });
+    loop.reset_timer(farInterval, 24 * 3600);
+
+    TimerId a = loop.run_after(0.05, [&]() { record(100); loop.quit(); });
+    loop.extend_timer(a, 0.1);
+
+    TimerId b = loop.run_after(1.0, [&]() { record(10); });
+    loop.reset_timer(b, 0.01);
+
+    // not earlier
+    TimerId c = loop.run_after(0.03, [&]() { record(30); });
+    loop.extend_timer(c, 0.001);
+
+    TimerId d = loop.run_after(0.02, [&]() { record(40); });
+    loop.reset_timer(d, 0.06);
+    loop.reset_timer(d, 0.04);
+
+    TimerId e;
+    e = loop.run_interval(0.005, [&]()
+    {
+        record(50);
+        loop.cancel_timer(e);
+    });
+    loop.extend_timer(e, 0.05);
+
+    loop.loop();
+
+    UNIT_TEST(true, order == std::vector<int>({ 10, 30, 40, 50, 100 }));
+    const std::int64_t expected[] = { 10000, 30000, 40000, 50000, 100000 };
+    for (std::size_t i = 0; i < elapsed.size() && i < 5; ++i)
+    {
+        UNIT_TEST(true, elapsed[i] >= expected[i]);
+    }
+    UNIT_TEST(5, loop.get_stats().timersFired);
+    loop.cancel_timer(far);
+    loop.cancel_timer(farInterval);
+}
+
+// the timerfd sets for timers each earlier than the ones before
+std::uint64_t count_timerfd_sets(double slack)
+{
+    EventLoop loop{ PollerType::EPOLL };
+    loop.set_timer_slack(slack);
+    std::uint64_t sets = loop.get_stats().timerfdSets;
+
+    // each one is the new earliest
+    const int kTimers = 100;
+    TimeStamp start = TimeStamp::now();
+    int fired = 0;
+    bool isNeverEarly = true;
+    for (int i = 0; i < kTimers; ++i)
+    {
+        TimeStamp when = start + Duration{ std::int64_t{ 30000 - i * 10 } };
+        loop.run_at(when, [&, when]()
+        {
+            TimeStamp now = TimeStamp::now();
+            isNeverEarly = isNeverEarly && !(now < when);
+            if (++fired == kTimers)
+            {
+                loop.quit();
+            }
+        });
+    }
+    sets = loop.get_stats().timerfdSets - sets;
+
+    loop.loop();
+
+    UNIT_TEST(kTimers, fired);
+    UNIT_TEST(true, isNeverEarly);
+    return sets;
+}
+
+void test_timer_slack()
+{
+    // without slack each new earliest timer sets the timerfd, with slack
+    // the ones in the bucket of the programmed expiration do not
+    std::uint64_t sets = count_timerfd_sets(0.0);
+    std::uint64_t slackSets = count_timerfd_sets(0.01);
+    UNIT_TEST(100, sets);
+    UNIT_TEST(true, slackSets < sets);
+}
+
+void test_poller(PollerType type, const char* name, bool deferred = false)
+{
+    EventLoop* loop = nullptr;
+    std::atomic<bool> started(false);
+    std::thread thread([&]()
+    {
+        EventLoop threadLoop{ type };
+        threadLoop.set_deferred_update(deferred);
+        loop = &threadLoop;
+        started = true;
+        threadLoop.loop();
+    });
+    while (!started)
+    {
+        std::this_thread::yield();
+    }
+
+    std::string pollerName = loop->get_poller_name();
+    // io_uring falls back to epoll on old kernels
+    UNIT_TEST(true, pollerName == name 
+        || (type == PollerType::IO_URING && pollerName == "epoll"));
+
+    int pipefd[2];
+    UNIT_TEST(0, ::pipe(pipefd));
+    std::unique_ptr<Channel> reader;
+    std::unique_ptr<Channel> writer;
+    std::atomic<int> reads(0);
+    std::atomic<int> writes(0);
+    std::atomic<int> timers(0);
+    loop->queue_in_loop([&]()
+    {
+        reader.reset(new Channel{ loop, pipefd[0] });
+        reader->set_read_callback([&](TimeStamp)
+        {
+            // one byte a time, the rest is reported again
+            char c;
+            UNIT_TEST(1, ::read(pipefd[0], &c, 1));
+            ++reads;
+        });
+        reader->enable_read();
+
+        writer.reset(new Channel{ loop, pipefd[1] });
+        writer->set_write_callback([&]()
+        {
+            ++writes;
+            writer->disable_write();
+        });
+        writer->enable_write();
+
+        loop->run_after(0.001, [&timers]() { ++timers; });
+    });
+    UNIT_TEST(3, ::write(pipefd[1], "abc", 3));
+
+    while (reads < 3 || writes < 1 || timers < 1)
+    {
+        std::this_thread::yield();
+    }
+
+    // the write interest is removed, enable it again
+    std::atomic<bool> done(false);
+    loop->queue_in_loop([&]()
+    {
+        writer->enable_write();
+        loop->queue_in_loop([&]() { done = true; });
+    });
+    while (!done || writes < 2)
+    {
+        std::this_thread::yield();
+    }
+
+    // the fd is removed, closed and reused by another channel
+    // in one iteration, the new channel gets the events
+    int reusedfd[2] = { -1, -1 };
+    std::unique_ptr<Channel> reused;
+    std::atomic<int> reusedReads(0);
+    loop->queue_in_loop([&]()
+    {
+        reader->disable_all();
+        reader->remove();
+        reader.reset();
+        ::close(pipefd[0]);
+
+        UNIT_TEST(0, ::pipe(reusedfd));
+        reused.reset(new Channel{ loop, reusedfd[0] });
+        reused->set_read_callback([&](TimeStamp)
+        {
+            char c;
+            UNIT_TEST(1, ::read(reusedfd[0], &c, 1));
+            ++reusedReads;
+        });
+        reused->enable_read();
+        // undone before polling
+        reused->enable_write();
+        reused->disable_write();
+        done = false;
+    });
+    while (done)
+    {
+        std::this_thread::yield();
+    }
+    UNIT_TEST(1, ::write(reusedfd[1], "x", 1));
+    while (reusedReads < 1)
+    {
+        std::this_thread::yield();
+    }
+
+    loop->queue_in_loop([&]()
+    {
+        reused->disable_all();
+        reused->remove();
+        reused.reset();
+        writer->disable_all();
+        writer->remove();
+        writer.reset();
+        done = true;
+    });
+    while (!done)
+    {
+        std::this_thread::yield();
+    }
+    loop->quit();
+    thread.join();
+    ::close(pipefd[1]);
+    ::close(reusedfd[0]);
+    ::close(reusedfd[1]);
+
+    UNIT_TEST(3, reads);
+    UNIT_TEST(2, writes);
+    UNIT_TEST(1, timers);
+    UNIT_TEST(1, reusedReads);
+}
+
+// more channels than the io_uring submission queue holds
+void test_many_channels(PollerType type)
+{
+    const int kChannels = 300;
+    EventLoop loop{ type };
+    std::vector<std::array<int, 2>> pipes(kChannels);
+    std::vector<std::unique_ptr<Channel>> channels;
+    int reads = 0;
+    for (auto& fds : pipes)
+    {
+        UNIT_TEST(0, ::pipe(fds.data()));
+        UNIT_TEST(1, ::write(fds[1], "x", 1));
+        int fd = fds[0];
+        channels.emplace_back(new Channel{ &loop, fd });
+        channels.back()->set_read_callback([&, fd](TimeStamp)
+        {
+            char c;
+            UNIT_TEST(1, ::read(fd, &c, 1));
+            if (++reads == kChannels)
+            {
+                loop.quit();
+            }
+        });
+        channels.back()->enable_read();
+    }
+
+    loop.loop();
+    UNIT_TEST(kChannels, reads);
+
+    for (int i = 0; i < kChannels; ++i)
+    {
+        channels[i]->disable_all();
+        channels[i]->remove();
+        ::close(pipes[i][0]);
+        ::close(pipes[i][1]);
+    }
+}
+
+void test_edge_triggered()
+{
+    {
+        EventLoop pollLoop{ PollerType::POLL };
+        pollLoop.set_edge_triggered(true);
+        UNIT_TEST(false, pollLoop.is_edge_triggered());
+    }
+
+    EventLoop* loop = nullptr;
+    std::atomic<bool> started(false);
+    std::thread thread([&]()
+    {
+        EventLoop threadLoop{ PollerType::EPOLL };
+        threadLoop.set_edge_triggered(true);
+        loop = &threadLoop;
+        started = true;
+        threadLoop.loop();
+    });
+    while (!started)
+    {
+        std::this_thread::yield();
+    }
+    UNIT_TEST(true, loop->is_edge_triggered());
+
+    int pipefd[2];
+    UNIT_TEST(0, ::pipe(pipefd));
+    std::unique_ptr<Channel> reader;
+    std::atomic<int> reads(0);
+    std::atomic<bool> done(false);
+    loop->queue_in_loop([&]()
+    {
+        reader.reset(new Channel{ loop, pipefd[0] });
+        reader->set_edge_triggered(loop->is_edge_triggered());
+        reader->set_read_callback([&](TimeStamp)
+        {
+            // one byte a time, the rest is not reported again
+            char c;
+            UNIT_TEST(1, ::read(pipefd[0], &c, 1));
+            ++reads;
+        });
+        reader->enable_read();
+        done = true;
+    });
+    while (!done)
+    {
+        std::this_thread::yield();
+    }
+
+    UNIT_TEST(3, ::write(pipefd[1], "abc", 3));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    UNIT_TEST(1, reads);
+
+    // new data is a new edge
+    UNIT_TEST(1, ::write(pipefd[1], "d", 1));
+    while (reads < 2)
+    {
+        std::this_thread::yield();
+    }
+
+    loop->queue_in_loop([&]()
+    {
+        reader->disable_all();
+        reader->remove();
+        reader.reset();
+        done = false;
+    });
+    while (done)
+    {
+        std::this_thread::yield();
+    }
+    loop->quit();
+    thread.join();
+    ::close(pipefd[0]);
+    ::close(pipefd[1]);
+
+    UNIT_TEST(2, reads);
+}
+
+void test_channel_priority()
+{
+    EventLoop loop{ PollerType::EPOLL };
+    const ChannelPriority priorities[] = {
+        ChannelPriority::LOW, ChannelPriority::NORMAL, ChannelPriority::HIGH
+    };
+
+    int pipefds[3][2];
+    std::vector<std::unique_ptr<Channel>> channels;
+    std::vector<ChannelPriority> handled;
+    for (int i = 0; i < 3; ++i)
+    {
+        UNIT_TEST(0, ::pipe(pipefds[i]));
+        int fd = pipefds[i][0];
+        ChannelPriority priority = priorities[i];
+        channels.emplace_back(new Channel{ &loop, fd });
+        channels.back()->set_priority(priority);
+        channels.back()->set_read_callback([&, fd, priority](TimeStamp)
+        {
+            char c;
+            UNIT_TEST(1, ::read(fd, &c, 1));
+            handled.push_back(priority);
+            if (priority == ChannelPriority::LOW)
+            {
+                loop.quit();
+            }
+        });
+        channels.back()->enable_read();
+        UNIT_TEST(1, ::write(pipefds[i][1], "x", 1));
+    }
+
+    // all readable in one poll
+    loop.loop();
+
+    UNIT_TEST(3, handled.size());
+    UNIT_TEST(true, handled == std::vector<ChannelPriority>(
+        { ChannelPriority::HIGH, ChannelPriority::NORMAL, ChannelPriority::LOW }));
+
+    for (int i = 0; i < 3; ++i)
+    {
+        channels[i]->disable_all();
+        channels[i]->remove();
+        ::close(pipefds[i][0]);
+        ::close(pipefds[i][1]);
+    }
+}
+
+// a connection on one end of a socketpair, the other end is blocking,
+// the small send buffer makes writes partial
+TcpConnectionPtr make_pair_connection(EventLoop* loop, int fds[2])
+{
+    UNIT_TEST(0, ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds));
+    ::fcntl(fds[0], F_SETFL, ::fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+    int sndbuf = 4096;
+    ::setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    auto conn = std::make_shared<TcpConnection>(loop, "pair", fds[0],
+        IpPort{}, IpPort{});
+    conn->set_connection_callback([](const TcpConnectionPtr&) {});
+    conn->set_message_callback(
+        [](const TcpConnectionPtr&, Buffer&, TimeStamp) {});
+    conn->set_close_callback([](const TcpConnectionPtr& c)
+    {
+        c->get_loop()->queue_in_loop(
+            std::bind(&TcpConnection::connect_destroy, c));
+    });
+    return conn;
+}
+
+// read until `len` bytes or the end of file
+std::string read_all(int fd, std::size_t len)
+{
+    std::string data;
+    char buf[64 * 1024];
+    while (data.size() < len)
+    {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n <= 0)
+        {
+            break;
+        }
+        data.append(buf, static_cast<std::size_t>(n));
+    }
+
+    return data;
+}
+
+void test_tcp_connection_send()
+{
+    EventLoop loop{ PollerType::EPOLL };
+    int fds[2];
+    TcpConnectionPtr conn = make_pair_connection(&loop, fds);
+    conn->connect_established();
+
+    // more pieces than a writev takes, all written, nothing queued
+    std::string scattered(IOV_MAX + 100, 's');
+    std::vector<struct iovec> many(scattered.size());
+    for (std::size_t i = 0; i < many.size(); ++i)
+    {
+        many[i].iov_base = &scattered[i];
+        many[i].iov_len = 1;
+    }
+    conn->send(many.data(), static_cast<int>(many.size()));
+    UNIT_TEST(true, conn->get_output_queue().empty());
+    std::string expected = scattered;
+
+    // the socket takes the head, the unwritten tail is queued
+    std::string body(256 * 1024, 'b');
+    conn->send({ StringView{ "<head>" }, StringView{ body }, 
+        StringView{ "<tail>" } });
+    std::size_t queued = conn->get_output_queue().readable_bytes();
+    UNIT_TEST(true, queued > 6);
+    UNIT_TEST(true, queued < body.size() + 12);
+    expected += "<head>" + body + "<tail>";
+
+    // more pieces than a gather send takes
+    std::vector<std::string> pieces;
+    for (int i = 0; i < 20; ++i)
+    {
+        pieces.push_back(std::to_string(i) + ",");
+        expected += pieces.back();
+    }
+    conn->send({ StringView{ pieces[0] }, StringView{ pieces[1] },
+        StringView{ pieces[2] }, StringView{ pieces[3] },
+        StringView{ pieces[4] }, StringView{ pieces[5] },
+        StringView{ pieces[6] }, StringView{ pieces[7] },
+        StringView{ pieces[8] }, StringView{ pieces[9] },
+        StringView{ pieces[10] }, StringView{ pieces[11] },
+        StringView{ pieces[12] }, StringView{ pieces[13] },
+        StringView{ pieces[14] }, StringView{ pieces[15] },
+        StringView{ pieces[16] }, StringView{ pieces[17] },
+        StringView{ pieces[18] }, StringView{ pieces[19] } });
+
+    // a literal is not ambiguous with send(std::string&&)
+    conn->send("<literal>");
+    expected += "<literal>";
+
+    std::string received;
+    std::thread reader([&]()
+    {
+        // a gather send from another thread, the pieces may be gone
+        // before the loop runs it
+        {
+            std::string first = "<other";
+            std::string second = "thread>";
+            struct iovec vec[2];
+            vec[0].iov_base = &first[0];
+            vec[0].iov_len = first.size();
+            vec[1].iov_base = &second[0];
+            vec[1].iov_len = second.size();
+            conn->send(vec, 2);
+        }
+
+        received = read_all(fds[1], expected.size() + 13);
+        loop.quit();
+    });
+    loop.loop();
+    reader.join();
+
+    expected += "<otherthread>";
+    UNIT_TEST(expected.size(), received.size());
+    UNIT_TEST(true, expected == received);
+    UNIT_TEST(true, conn->get_output_queue().empty());
+
+    conn->connect_destroy();
+    ::close(fds[1]);
+}
+
+void test_tcp_connection_read()
+{
+    EventLoop loop{ PollerType::EPOLL };
+    loop.set_buffer_pooling(true);
+    int fds[2];
+    TcpConnectionPtr conn = make_pair_connection(&loop, fds);
+    std::size_t received = 0;
+    std::size_t expected = 0;
+    conn->set_message_callback(
+        [&](const TcpConnectionPtr&, Buffer& buf, TimeStamp)
+    {
+        received += buf.readable_bytes();
+        buf.retrieve_all();
+        if (received == expected)
+        {
+            loop.quit();
+        }
+    });
+    conn->connect_established();
+    UNIT_TEST(1024, conn->get_read_size());
+
+    // the data is in the socket before the loop polls
+    auto transfer = [&](std::size_t len)
+    {
+        std::string data(len, 'r');
+        UNIT_TEST(static_cast<ssize_t>(len), 
+            ::write(fds[1], data.data(), len));
+        expected += len;
+        loop.loop();
+    };
+
+    // one read per event by default, full reads grow the read size
+    const TcpConnection::ReadStats& stats = conn->get_read_stats();
+    transfer(96 * 1024);
+    UNIT_TEST(expected, stats.bytes);
+    UNIT_TEST(stats.events, stats.reads);
+    UNIT_TEST(true, stats.events >= 2);
+    std::size_t grown = conn->get_read_size();
+    UNIT_TEST(true, grown > 1024);
+
+    // a pooled block is not grown for the read size and goes back
+    transfer(100);
+    UNIT_TEST(1, loop.get_buffer_pool().free_blocks());
+
+    // short reads shrink the read size
+    for (int i = 0; i < 4; ++i)
+    {
+        transfer(10);
+    }
+    UNIT_TEST(true, conn->get_read_size() < grown);
+
+    // a budget keeps reading in the same event
+    conn->set_read_budget(1024 * 1024);
+    std::uint64_t events = stats.events;
+    std::uint64_t reads = stats.reads;
+    transfer(96 * 1024);
+    UNIT_TEST(events + 1, stats.events);
+    UNIT_TEST(reads + 2, stats.reads);
+    UNIT_TEST(expected, stats.bytes);
+    UNIT_TEST(expected, received);
+
+    conn->connect_destroy();
+    ::close(fds[1]);
+}
+
+// without pooling, a drained input buffer is not kept much larger
+// than the read size
+void test_tcp_connection_read_shrink()
+{
+    EventLoop loop{ PollerType::EPOLL };
+    int fds[2];
+    TcpConnectionPtr conn = make_pair_connection(&loop, fds);
+    std::size_t received = 0;
+    std::size_t expected = 0;
+    conn->set_message_callback(
+        [&](const TcpConnectionPtr&, Buffer& buf, TimeStamp)
+    {
+        received += buf.readable_bytes();
+        buf.retrieve_all();
+        if (received == expected)
+        {
+            loop.quit();
+        }
+    });
+    conn->connect_established();
+
+    const Buffer& input = conn->get_input_buffer();
+    for (std::size_t len : { 96 * 1024, 10, 10, 10, 10 })
+    {
+        std::string data(len, 'p');
+        UNIT_TEST(static_cast<ssize_t>(len), 
+            ::write(fds[1], data.data(), len));
+        expected += len;
+        loop.loop();
+        UNIT_TEST(true, input.writable_bytes() <= 2 * conn->get_read_size());
+    }
+    UNIT_TEST(expected, received);
+
+    conn->connect_destroy();
+    ::close(fds[1]);
+}
+
+void test_tcp_connection_edge_triggered()
+{
+    EventLoop loop{ PollerType::EPOLL };
+    loop.set_edge_triggered(true);
+    int fds[2];
+    TcpConnectionPtr conn = make_pair_connection(&loop, fds);
+    std::size_t received = 0;
+    std::size_t expected = 0;
+    conn->set_message_callback(
+        [&](const TcpConnectionPtr&, Buffer& buf, TimeStamp)
+    {
+        received += buf.readable_bytes();
+        buf.retrieve_all();
+        if (received == expected)
+        {
+            loop.quit();
+        }
+    });
+    bool closed = false;
+    conn->set_close_callback([&](const TcpConnectionPtr& c)
+    {
+        closed = true;
+        loop.queue_in_loop(std::bind(&TcpConnection::connect_destroy, c));
+        loop.queue_in_loop([&]() { loop.quit(); });
+    });
+    conn->connect_established();
+
+    // the data is written once, so there is one edge only
+    auto transfer = [&](std::size_t len)
+    {
+        std::string data(len, 'e');
+        UNIT_TEST(static_cast<ssize_t>(len),
+            ::write(fds[1], data.data(), len));
+        expected += len;
+        loop.loop();
+    };
+
+    // more than one read's worth is read until EAGAIN in one event
+    const TcpConnection::ReadStats& stats = conn->get_read_stats();
+    transfer(96 * 1024);
+    UNIT_TEST(expected, received);
+    UNIT_TEST(1, stats.events);
+    UNIT_TEST(true, stats.reads >= 2);
+
+    // a budget stops the reads, the rest is read by the continuation
+    // without a new edge
+    conn->set_read_budget(4096);
+    std::uint64_t events = stats.events;
+    transfer(96 * 1024);
+    UNIT_TEST(expected, received);
+    UNIT_TEST(true, stats.events >= events + 2);
+
+    // the write interest stays, the queue drains on writable edges,
+    // the write side is shut down only after it
+    std::string body(512 * 1024, 's');
+    conn->send(StringView{ body });
+    UNIT_TEST(false, conn->get_output_queue().empty());
+    conn->shutdown();
+
+    std::string data;
+    std::thread reader([&]()
+    {
+        // to the end of file
+        data = read_all(fds[1], body.size() + 1);
+        ::close(fds[1]);
+    });
+    loop.loop();
+    reader.join();
+
+    UNIT_TEST(body.size(), data.size());
+    UNIT_TEST(true, body == data);
+    UNIT_TEST(true, conn->get_output_queue().empty());
+    UNIT_TEST(true, closed);
+}
+
+void test_pollers()
+{
+    test_poller(PollerType::POLL, "poll");
+    test_poller(PollerType::EPOLL, "epoll");
+    test_poller(PollerType::IO_URING, "io_uring");
+    test_poller(PollerType::EPOLL, "epoll", true);
+    test_many_channels(PollerType::POLL);
+    test_many_channels(PollerType::EPOLL);
+    test_many_channels(PollerType::IO_URING);
+    test_edge_triggered();
+    test_channel_priority();
+}
 
 void test_all()
 {
     test_any();
     test_time_stamp();
+    test_byte_search();
+    test_buffer();
+    test_output_queue();
+    test_mpsc_queue();
+    test_task();
+    test_event_loop();
+    test_timing_wheel();
+    test_reset_timer(false);
+    test_reset_timer(true);
+    test_timer_slack();
+    test_pollers();
+    test_tcp_connection_send();
+    test_tcp_connection_read();
+    test_tcp_connection_read_shrink();
+    test_tcp_connection_edge_triggered();
     test_json();
     test_log();
 
@@ -615,12 +1943,218 @@ void test_client()
     std::this_thread::sleep_for(2s);
 }
 
-int main()
+// the pending functions queue before the MPSC queue, for comparison
+class MutexQueue
+{
+public:
+    void push(EventLoop::Function function)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFunctions.push_back(std::move(function));
+    }
+
+    // take all the functions at once
+    void pop_all(std::vector<EventLoop::Function>& functions)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        functions.swap(mFunctions);
+    }
+
+private:
+    std::mutex mMutex;
+    std::vector<EventLoop::Function> mFunctions;
+};
+
+// `producers` threads post no-op functions, this thread runs them,
+// return posts per second
+template <typename Post, typename Drain>
+double bench_posts(int producers, Post post, Drain drain)
+{
+    const int kPosts = 1000000;
+    const int perProducer = kPosts / producers;
+    std::atomic<int> run(0);
+
+    TimeStamp start = TimeStamp::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&post, &run, perProducer]() {
+            for (int i = 0; i < perProducer; ++i)
+            {
+                post([&run]() { 
+                    run.store(run.load(std::memory_order_relaxed) + 1, 
+                              std::memory_order_relaxed); 
+                });
+            }
+        });
+    }
+
+    while (run.load(std::memory_order_relaxed) < perProducer * producers)
+    {
+        if (!drain())
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    double seconds = static_cast<double>(
+        (TimeStamp::now() - start).to_microseconds()) / 1000000.0;
+    return perProducer * producers / seconds;
+}
+
+// ./unit_test bench
+void bench_pending_functions()
+{
+    for (int producers : { 1, 2, 4, 8 })
+    {
+        MpscQueue<EventLoop::Function> mpsc;
+        double mpscRate = bench_posts(producers, 
+            [&mpsc](EventLoop::Function f) { mpsc.push(std::move(f)); },
+            [&mpsc]() 
+            {
+                bool any = false;
+                while (mpsc.consume(
+                    [](EventLoop::Function& function) { function(); }))
+                {
+                    any = true;
+                }
+                return any;
+            });
+
+        MutexQueue locked;
+        std::vector<EventLoop::Function> functions;
+        double mutexRate = bench_posts(producers, 
+            [&locked](EventLoop::Function f) { locked.push(std::move(f)); },
+            [&locked, &functions]()
+            {
+                functions.clear();
+                locked.pop_all(functions);
+                for (auto& function : functions)
+                {
+                    function();
+                }
+                return !functions.empty();
+            });
+
+        std::cout << producers << " producers: mpsc " 
+            << static_cast<long>(mpscRate) << " posts/s, mutex " 
+            << static_cast<long>(mutexRate) << " posts/s" << std::endl;
+    }
+}
+
+// `count` idle channels and a few active ones on a loop of `type`,
+// ns per add, update and remove, and us per iteration polling them
+void bench_poller(PollerType type, int count)
+{
+    const int kActive = 16;
+    const int kIterations = 200;
+    EventLoop loop{ type };
+
+    // dups of an eventfd never written, the channels stay idle
+    int idle = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    std::vector<int> fds;
+    for (int i = 0; i < count; ++i)
+    {
+        fds.push_back(::dup(idle));
+    }
+
+    auto ns_per = [](TimeStamp start, std::size_t ops)
+    {
+        return static_cast<double>(
+            (TimeStamp::now() - start).to_microseconds()) * 1000.0 / ops;
+    };
+
+    std::vector<std::unique_ptr<Channel>> channels;
+    TimeStamp start = TimeStamp::now();
+    for (int fd : fds)
+    {
+        channels.emplace_back(new Channel(&loop, fd));
+        channels.back()->enable_read();
+    }
+    double addNs = ns_per(start, fds.size());
+
+    start = TimeStamp::now();
+    for (auto& channel : channels)
+    {
+        channel->enable_write();
+        channel->disable_write();
+    }
+    double updateNs = ns_per(start, 2 * channels.size());
+
+    // an eventfd with a count stays readable
+    int run = 0;
+    for (int i = 0; i < kActive; ++i)
+    {
+        fds.push_back(::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC));
+        channels.emplace_back(new Channel(&loop, fds.back()));
+        channels.back()->set_read_callback([&run, &loop](TimeStamp)
+        {
+            if (++run == kActive * kIterations)
+            {
+                loop.quit();
+            }
+        });
+        channels.back()->enable_read();
+    }
+    start = TimeStamp::now();
+    loop.loop();
+    double pollUs = ns_per(start, kIterations) / 1000.0;
+
+    start = TimeStamp::now();
+    for (auto& channel : channels)
+    {
+        channel->disable_all();
+        channel->remove();
+    }
+    double removeNs = ns_per(start, channels.size());
+
+    for (int fd : fds)
+    {
+        ::close(fd);
+    }
+    ::close(idle);
+
+    std::cout << loop.get_poller_name() << " " << count << " channels: add " 
+        << addNs << " ns, update " << updateNs << " ns, remove " 
+        << removeNs << " ns, poll " << pollUs << " us" << std::endl;
+}
+
+// ./unit_test bench, 100k channels or as many as RLIMIT_NOFILE allows
+void bench_pollers()
+{
+    struct rlimit limit;
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &limit);
+
+    // leave some fds for the loop and the active channels
+    const rlim_t kChannels = 100000;
+    int count = static_cast<int>(std::min(kChannels, limit.rlim_cur - 64));
+    for (PollerType type : 
+        { PollerType::POLL, PollerType::EPOLL, PollerType::IO_URING })
+    {
+        bench_poller(type, count);
+    }
+}
+
+int main(int argc, char* argv[])
 {
     //std::cout << "main thread id = " << std::this_thread::get_id() << std::endl;
     //// Logger::set_level(LogLevel::TRACE);
     //test_client();
     
+    if (argc > 1 && std::string(argv[1]) == "bench")
+    {
+        bench_pending_functions();
+        bench_pollers();
+        return 0;
+    }
+
     test_all();
 
     return 0;